@@ -0,0 +1,485 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <metis.h>
+#include "graph_components.h"
+
+static int online_cpus(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// Korzeń zbioru x z kompresją ścieżki przez połowienie. Rodzic ma zawsze
+// mniejszy indeks, więc równoległe zapisy jedynie skracają ścieżki.
+static gidx_t uf_find(gidx_t* parent, gidx_t x)
+{
+    for (;;) {
+        gidx_t p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED);
+        if (p == x) return x;
+        gidx_t gp = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+        if (gp != p) {
+            __atomic_compare_exchange_n(&parent[x], &p, gp, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+        x = gp;
+    }
+}
+
+static void uf_union(gidx_t* parent, gidx_t u, gidx_t v)
+{
+    for (;;) {
+        u = uf_find(parent, u);
+        v = uf_find(parent, v);
+        if (u == v) return;
+        // Podpinamy korzeń o większym indeksie pod mniejszy
+        if (u < v) {
+            gidx_t tmp = u;
+            u = v;
+            v = tmp;
+        }
+        gidx_t expected = u;
+        if (__atomic_compare_exchange_n(&parent[u], &expected, v, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+typedef struct {
+    Graph* graph;
+    gidx_t* parent;
+    gidx_t begin;
+    gidx_t end;
+    int running;
+} UnionTask;
+
+static void* union_edges(void* arg)
+{
+    UnionTask* task = (UnionTask*)arg;
+    gidx_t nvtxs = task->graph->nvtxs;
+    goff_t* xadj = task->graph->xadj;
+    gidx_t* adjncy = task->graph->adjncy;
+
+    for (gidx_t v = task->begin; v < task->end; v++) {
+        for (goff_t e = xadj[v]; e < xadj[v + 1]; e++) {
+            gidx_t u = adjncy[e];
+            // Krawędzie do nieistniejących wierzchołków pomijamy, tak jak przy wyodrębnianiu
+            if (u >= 0 && u < nvtxs && u != v) {
+                uf_union(task->parent, v, u);
+            }
+        }
+    }
+    return NULL;
+}
+
+int compute_components(Graph* graph)
+{
+    gidx_t nvtxs = graph->nvtxs;
+    gidx_t* parent = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+    gidx_t* component_ptr = (gidx_t*)malloc(((size_t)nvtxs + 1) * sizeof(gidx_t));
+    if ((!parent && nvtxs > 0) || !component_ptr) {
+        printf("Unable to allocate union-find arrays\n");
+        free(parent);
+        free(component_ptr);
+        return -1;
+    }
+
+    for (gidx_t v = 0; v < nvtxs; v++) {
+        parent[v] = v;
+    }
+
+    int threads_count = online_cpus();
+    if (threads_count > nvtxs) threads_count = nvtxs > 0 ? (int)nvtxs : 1;
+
+    UnionTask* tasks = (UnionTask*)malloc(threads_count * sizeof(UnionTask));
+    pthread_t* threads = (pthread_t*)malloc(threads_count * sizeof(pthread_t));
+    if (!tasks || !threads) {
+        printf("Unable to allocate union-find threads\n");
+        free(tasks);
+        free(threads);
+        free(parent);
+        free(component_ptr);
+        return -1;
+    }
+
+    // Zakresy wierzchołków o zbliżonej liczbie krawędzi
+    goff_t total_edges = graph->xadj[nvtxs];
+    gidx_t v = 0;
+    for (int t = 0; t < threads_count; t++) {
+        goff_t edge_limit = (goff_t)((double)total_edges * (t + 1) / threads_count);
+        tasks[t].graph = graph;
+        tasks[t].parent = parent;
+        tasks[t].begin = v;
+        while (v < nvtxs && (graph->xadj[v] < edge_limit || t == threads_count - 1)) {
+            v++;
+        }
+        tasks[t].end = v;
+    }
+
+    for (int t = 0; t < threads_count; t++) {
+        if (pthread_create(&threads[t], NULL, union_edges, &tasks[t]) != 0) {
+            // Zakres, dla którego nie udało się uruchomić wątku, liczymy w bieżącym
+            tasks[t].running = 0;
+            union_edges(&tasks[t]);
+        } else {
+            tasks[t].running = 1;
+        }
+    }
+    for (int t = 0; t < threads_count; t++) {
+        if (tasks[t].running) pthread_join(threads[t], NULL);
+    }
+    free(tasks);
+    free(threads);
+
+    // Spłaszczenie drzew: każdy wierzchołek wskazuje bezpośrednio na korzeń
+    for (gidx_t u = 0; u < nvtxs; u++) {
+        parent[u] = uf_find(parent, u);
+    }
+
+    // Korzeń jest najmniejszym wierzchołkiem składowej, więc numeracja według
+    // korzeni zachowuje kolejność pierwszego wystąpienia. Numery zapisujemy
+    // tymczasowo jako -(c + 1), żeby odróżnić je od indeksów korzeni.
+    gidx_t num_components = 0;
+    for (gidx_t u = 0; u < nvtxs; u++) {
+        if (parent[u] == u) {
+            component_ptr[num_components] = 0;
+            parent[u] = -(num_components + 1);
+            num_components++;
+        } else {
+            parent[u] = parent[parent[u]];
+        }
+        component_ptr[-parent[u] - 1]++;
+    }
+
+    gidx_t sum = 0;
+    for (gidx_t c = 0; c < num_components; c++) {
+        gidx_t size = component_ptr[c];
+        component_ptr[c] = sum;
+        sum += size;
+    }
+    component_ptr[num_components] = sum;
+
+    for (gidx_t u = 0; u < nvtxs; u++) {
+        parent[u] = -parent[u] - 1;
+    }
+
+    free(graph->components);
+    free(graph->component_ptr);
+    graph->components = parent;
+    graph->component_ptr = component_ptr;
+    graph->num_components = num_components;
+
+    printf("Liczba spójnych składowych: %" PRIgidx "\n", num_components);
+    return 0;
+}
+
+typedef struct {
+    gidx_t comp;
+    gidx_t size;
+    int nparts;
+    int first_part;
+} ComponentJob;
+
+typedef struct {
+    Graph* graph;
+    const gidx_t* order;
+    const gidx_t* local_index;
+    ComponentJob* jobs;
+    int jobs_count;
+    int* next_job;
+    pthread_mutex_t* lock;
+    gidx_t max_load;
+    int seeds_count;
+    idx_t* parts;
+    goff_t cut;
+    int failed;
+} ComponentWorker;
+
+static int compare_jobs_by_size(const void* a, const void* b)
+{
+    const ComponentJob* x = (const ComponentJob*)a;
+    const ComponentJob* y = (const ComponentJob*)b;
+    if (x->size != y->size) return x->size < y->size ? 1 : -1;
+    return x->comp < y->comp ? -1 : (x->comp > y->comp);
+}
+
+// Partycjonuje jedną składową jako osobny graf o lokalnej numeracji wierzchołków
+static int partition_component(ComponentWorker* w, ComponentJob* job)
+{
+    Graph* graph = w->graph;
+    gidx_t nvtxs = graph->nvtxs;
+    const gidx_t* members = w->order + graph->component_ptr[job->comp];
+
+    goff_t edges = 0;
+    for (gidx_t i = 0; i < job->size; i++) {
+        gidx_t v = members[i];
+        edges += graph->xadj[v + 1] - graph->xadj[v];
+    }
+
+    Graph sub;
+    memset(&sub, 0, sizeof(sub));
+    sub.nvtxs = job->size;
+    sub.xadj = (goff_t*)malloc(((size_t)job->size + 1) * sizeof(goff_t));
+    sub.adjncy = (gidx_t*)malloc((size_t)edges * sizeof(gidx_t));
+    if (!sub.xadj || (!sub.adjncy && edges > 0)) {
+        printf("Unable to allocate component %" PRIgidx " subgraph\n", job->comp);
+        free(sub.xadj);
+        free(sub.adjncy);
+        return -1;
+    }
+
+    goff_t current_edge = 0;
+    sub.xadj[0] = 0;
+    for (gidx_t i = 0; i < job->size; i++) {
+        gidx_t v = members[i];
+        for (goff_t e = graph->xadj[v]; e < graph->xadj[v + 1]; e++) {
+            gidx_t u = graph->adjncy[e];
+            if (u >= 0 && u < nvtxs) {
+                sub.adjncy[current_edge++] = w->local_index[u];
+            }
+        }
+        sub.xadj[i + 1] = current_edge;
+    }
+
+    // Margines składowej dobrany tak, żeby każda z jej partycji mieściła się w limicie całego grafu
+    float margin = (float)((double)w->max_load * job->nparts / job->size);
+    goff_t cut = 0;
+    idx_t* local_parts = Graph_parts_multi(&sub, job->nparts, margin, w->seeds_count, 1, &cut);
+    free(sub.xadj);
+    free(sub.adjncy);
+    if (!local_parts) {
+        return -1;
+    }
+
+    for (gidx_t i = 0; i < job->size; i++) {
+        w->parts[members[i]] = job->first_part + local_parts[i];
+    }
+    free(local_parts);
+
+    w->cut += cut;
+    return 0;
+}
+
+static void* component_worker_run(void* arg)
+{
+    ComponentWorker* w = (ComponentWorker*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(w->lock);
+        int job = (*w->next_job)++;
+        pthread_mutex_unlock(w->lock);
+        if (job >= w->jobs_count) break;
+
+        if (partition_component(w, &w->jobs[job]) != 0) {
+            w->failed = 1;
+        }
+    }
+    return NULL;
+}
+
+// Kopiec minimalny partycji według obciążenia
+static void heap_sift_down(int* heap, int count, const gidx_t* load, int i)
+{
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < count && load[heap[left]] < load[heap[smallest]]) smallest = left;
+        if (right < count && load[heap[right]] < load[heap[smallest]]) smallest = right;
+        if (smallest == i) return;
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Limit wierzchołków w partycji liczony jak w max_part_load, ale w gidx_t,
+// bo graf podzielony na składowe nie musi mieścić się w idx_t METIS
+static gidx_t component_max_load(gidx_t nvtxs, int partions_count, float error_margin)
+{
+    gidx_t limit = (gidx_t)(error_margin * (double)nvtxs / partions_count);
+    gidx_t ceil_avg = (nvtxs + partions_count - 1) / partions_count;
+    return limit < ceil_avg ? ceil_avg : limit;
+}
+
+idx_t* Graph_parts_by_component(Graph* graph, int partions_count, float error_margin, int seeds_count, int max_parallel, goff_t* deleted_edges)
+{
+    gidx_t nvtxs = graph->nvtxs;
+    gidx_t num_components = graph->num_components;
+
+    idx_t* parts = (idx_t*)malloc((size_t)nvtxs * sizeof(idx_t));
+    gidx_t* order = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+    gidx_t* local_index = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+    gidx_t* cursor = (gidx_t*)malloc(((size_t)num_components + 1) * sizeof(gidx_t));
+    ComponentJob* jobs = (ComponentJob*)malloc(((size_t)num_components + 1) * sizeof(ComponentJob));
+    gidx_t* load = (gidx_t*)calloc(partions_count, sizeof(gidx_t));
+    int* heap = (int*)malloc(partions_count * sizeof(int));
+
+    if (!parts || !order || !local_index || !cursor || !jobs || !load || !heap) {
+        printf("Błąd alokacji pamięci w Graph_parts_by_component\n");
+        free(parts);
+        free(order);
+        free(local_index);
+        free(cursor);
+        free(jobs);
+        free(load);
+        free(heap);
+        return NULL;
+    }
+
+    // Wierzchołki uporządkowane według składowych (component_ptr to początki grup)
+    for (gidx_t c = 0; c < num_components; c++) {
+        cursor[c] = graph->component_ptr[c];
+    }
+    for (gidx_t v = 0; v < nvtxs; v++) {
+        gidx_t c = graph->components[v];
+        local_index[v] = cursor[c] - graph->component_ptr[c];
+        order[cursor[c]++] = v;
+    }
+
+    for (gidx_t c = 0; c < num_components; c++) {
+        jobs[c].comp = c;
+        jobs[c].size = graph->component_ptr[c + 1] - graph->component_ptr[c];
+        jobs[c].nparts = 0;
+        jobs[c].first_part = 0;
+    }
+    qsort(jobs, (size_t)num_components, sizeof(ComponentJob), compare_jobs_by_size);
+
+    // Składowe większe niż limit partycji dostają tyle własnych partycji, ile
+    // potrzeba, żeby każda zmieściła się w limicie; pozostałe są pakowane
+    gidx_t max_load = component_max_load(nvtxs, partions_count, error_margin);
+    int next_part = 0;
+    gidx_t large_count = 0;
+    int fits = 1;
+    while (large_count < num_components && jobs[large_count].size > max_load) {
+        ComponentJob* job = &jobs[large_count];
+        gidx_t k = (job->size + max_load - 1) / max_load;
+        if (k > partions_count - next_part) {
+            fits = 0;
+            break;
+        }
+        job->nparts = (int)k;
+        job->first_part = next_part;
+        next_part += (int)k;
+        large_count++;
+    }
+
+    // Niezależne partycjonowanie dużych składowych w puli wątków. Wywołania METIS
+    // są szeregowane (globalny generator losowy), więc wątki zrównoleglają
+    // budowę podgrafów, a próby każdej składowej liczone są po kolei.
+    int threads_count = max_parallel > 0 ? max_parallel : online_cpus();
+    if (threads_count > large_count) threads_count = (int)large_count;
+
+    goff_t cut = 0;
+    int failed = 0;
+    if (fits && large_count > 0) {
+        ComponentWorker* workers = (ComponentWorker*)calloc(threads_count, sizeof(ComponentWorker));
+        pthread_t* threads = (pthread_t*)malloc(threads_count * sizeof(pthread_t));
+        pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+        int next_job = 0;
+
+        if (!workers || !threads) {
+            printf("Błąd alokacji pamięci dla wątków partycjonowania\n");
+            failed = 1;
+        } else {
+            int started = 0;
+            for (int t = 0; t < threads_count; t++) {
+                workers[t].graph = graph;
+                workers[t].order = order;
+                workers[t].local_index = local_index;
+                workers[t].jobs = jobs;
+                workers[t].jobs_count = (int)large_count;
+                workers[t].next_job = &next_job;
+                workers[t].lock = &lock;
+                workers[t].max_load = max_load;
+                workers[t].seeds_count = seeds_count;
+                workers[t].parts = parts;
+                if (pthread_create(&threads[t], NULL, component_worker_run, &workers[t]) != 0) {
+                    break;
+                }
+                started++;
+            }
+            if (started == 0) {
+                component_worker_run(&workers[0]);
+                started = 1;
+            } else {
+                for (int t = 0; t < started; t++) {
+                    pthread_join(threads[t], NULL);
+                }
+            }
+            for (int t = 0; t < started; t++) {
+                cut += workers[t].cut;
+                failed |= workers[t].failed;
+            }
+        }
+        free(workers);
+        free(threads);
+    }
+
+    gidx_t heaviest = 0;
+    if (fits && !failed) {
+        // Obciążenie partycji po podziale dużych składowych
+        for (gidx_t j = 0; j < large_count; j++) {
+            const gidx_t* members = order + graph->component_ptr[jobs[j].comp];
+            for (gidx_t i = 0; i < jobs[j].size; i++) {
+                load[parts[members[i]]]++;
+            }
+        }
+
+        // Małe składowe od największej trafiają do najmniej obciążonej partycji
+        for (int p = 0; p < partions_count; p++) {
+            heap[p] = p;
+        }
+        for (int i = partions_count / 2 - 1; i >= 0; i--) {
+            heap_sift_down(heap, partions_count, load, i);
+        }
+        for (gidx_t j = large_count; j < num_components; j++) {
+            int p = heap[0];
+            const gidx_t* members = order + graph->component_ptr[jobs[j].comp];
+            for (gidx_t i = 0; i < jobs[j].size; i++) {
+                parts[members[i]] = p;
+            }
+            load[p] += jobs[j].size;
+            heap_sift_down(heap, partions_count, load, 0);
+        }
+
+        for (int p = 0; p < partions_count; p++) {
+            if (load[p] > heaviest) heaviest = load[p];
+        }
+    }
+
+    free(order);
+    free(local_index);
+    free(cursor);
+    free(jobs);
+    free(load);
+    free(heap);
+
+    if (failed) {
+        printf("Błąd partycjonowania składowych\n");
+        free(parts);
+        return NULL;
+    }
+
+    // Gdy składowych nie da się rozłożyć w limicie, dzielimy cały graf naraz;
+    // METIS może wtedy rozciąć składowe między partycje
+    if (!fits || heaviest > max_load) {
+        if (!fits) {
+            printf("Duże składowe wymagają więcej niż %d partycji przy limicie %" PRIgidx ", partycjonowanie całego grafu\n",
+                   partions_count, max_load);
+        } else {
+            printf("Podział według składowych przekracza limit (%" PRIgidx "/%" PRIgidx "), partycjonowanie całego grafu\n",
+                   heaviest, max_load);
+        }
+        free(parts);
+        // Funkcja może działać w wątku serwera, więc próby liczymy bez procesów potomnych
+        return Graph_parts_multi(graph, partions_count, error_margin, seeds_count, 1, deleted_edges);
+    }
+
+    printf("Składowe: %" PRIgidx " partycjonowane osobno, %" PRIgidx " upakowane w partycje, cięcie %" PRIgoff ", największa partycja %" PRIgidx "/%" PRIgidx "\n",
+           large_count, num_components - large_count, cut, heaviest, max_load);
+    *deleted_edges = cut;
+    return parts;
+}
@@ -0,0 +1,19 @@
+#ifndef GRAPH_COMPONENTS_H
+#define GRAPH_COMPONENTS_H
+
+#include "graph_partion.h"
+
+// Wyznacza spójne składowe bezpośrednio z xadj/adjncy (równoległy union-find)
+// i zastępuje nimi components/component_ptr grafu: components[v] to numer
+// składowej wierzchołka v, component_ptr - skumulowane rozmiary składowych.
+int compute_components(Graph* graph);
+
+// Partycjonuje każdą składową większą niż limit partycji (max_part_load) niezależnie
+// (równolegle) na tyle części, żeby każda mieściła się w limicie, a małe składowe
+// rozkłada na najmniej obciążone partycje. Jeśli wynik przekroczyłby limit, dzieli
+// cały graf przez Graph_parts_multi. Składowe obsługuje najwyżej max_parallel
+// wątków (0 - tyle, ile rdzeni); wywołania METIS są przy tym szeregowane.
+// Wymaga wcześniejszego compute_components.
+idx_t* Graph_parts_by_component(Graph* graph, int partions_count, float error_margin, int seeds_count, int max_parallel, goff_t* deleted_edges);
+
+#endif
@@ -0,0 +1,526 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "graph_io.h"
+
+// Pierwsze pole binarnego pliku grafu z 64-bitowym nagłówkiem (max_neighbors nie bywa ujemne)
+#define GRAPH_BINARY_WIDE -1
+
+// Wartość poza zakresem typu docelowego ustawia *overflow
+static int64_t parse_value(const char *token, int64_t max_value, int *overflow) {
+    long long value = strtoll(token, NULL, 10);
+    if (value > max_value || value < -max_value - 1) {
+        *overflow = 1;
+    }
+    return value;
+}
+
+gidx_t* parse_section(char *line, goff_t *size, int *overflow) {
+    gidx_t *arr = NULL;
+    goff_t capacity = 0;
+    char *token = strtok(line, ";");
+
+    while (token) {
+        if (*size >= capacity) {
+            capacity = capacity ? capacity * 2 : 1;
+            arr = realloc(arr, (size_t)capacity * sizeof(gidx_t));
+        }
+        arr[(*size)++] = (gidx_t)parse_value(token, GIDX_MAX, overflow);
+        token = strtok(NULL, ";");
+    }
+    return arr;
+}
+
+goff_t* parse_offsets(char *line, goff_t *size, int *overflow) {
+    goff_t *arr = NULL;
+    goff_t capacity = 0;
+    char *token = strtok(line, ";");
+
+    while (token) {
+        if (*size >= capacity) {
+            capacity = capacity ? capacity * 2 : 1;
+            arr = realloc(arr, (size_t)capacity * sizeof(goff_t));
+        }
+        arr[(*size)++] = (goff_t)parse_value(token, GOFF_MAX, overflow);
+        token = strtok(NULL, ";");
+    }
+    return arr;
+}
+
+int detect_file_type(const char *filename) {
+    char *ext = strrchr(filename, '.');
+    if (ext && strcmp(ext, ".bin") == 0) {
+        return BINARY_MODE;
+    }
+    return TEXT_MODE;
+}
+
+// Wczytuje kolejną linię dowolnej długości; brakująca linia jest traktowana jak pusta sekcja
+static char* read_line(FILE *fp, char **line, size_t *capacity) {
+    if (getline(line, capacity, fp) < 0) {
+        if (!*line) {
+            *line = malloc(1);
+            *capacity = 1;
+        }
+        if (*line) (*line)[0] = '\0';
+    }
+    return *line;
+}
+
+Graph* read_graph_text(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return NULL;
+    }
+
+    Graph *graph = calloc(1, sizeof(Graph));
+    if (!graph) {
+        fprintf(stderr, "Error: Unable to allocate graph for %s\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+    char *line = NULL;
+    size_t capacity = 0;
+    int overflow = 0;
+
+    // Section 1: max_neighbors
+    read_line(fp, &line, &capacity);
+    graph->max_neighbors = (gidx_t)parse_value(line, GIDX_MAX, &overflow);
+
+    // Section 2: adjncy
+    goff_t adjncy_size = 0;
+    read_line(fp, &line, &capacity);
+    graph->adjncy = parse_section(line, &adjncy_size, &overflow);
+
+    // Section 3: xadj
+    goff_t xadj_size = 0;
+    read_line(fp, &line, &capacity);
+    graph->xadj = parse_offsets(line, &xadj_size, &overflow);
+    if (xadj_size - 1 > GIDX_MAX) overflow = 1;
+    graph->nvtxs = (gidx_t)(xadj_size - 1);
+
+    // Section 4: components
+    goff_t components_size = 0;
+    read_line(fp, &line, &capacity);
+    graph->components = parse_section(line, &components_size, &overflow);
+
+    // Section 5: component_ptr
+    goff_t component_ptr_size = 0;
+    read_line(fp, &line, &capacity);
+    graph->component_ptr = parse_section(line, &component_ptr_size, &overflow);
+    graph->num_components = (gidx_t)(component_ptr_size - 1);
+
+    free(line);
+    fclose(fp);
+
+    if (overflow) {
+        fprintf(stderr, "Error: %s does not fit in %d-bit vertex ids / %d-bit offsets, rebuild with INDEX=64\n",
+                filename, (int)(sizeof(gidx_t) * 8), (int)(sizeof(goff_t) * 8));
+        free_graph(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+static int64_t load_value(const void *src, size_t width) {
+    return width == sizeof(int32_t) ? *(const int32_t*)src : *(const int64_t*)src;
+}
+
+static int store_value(void *dst, size_t width, int64_t value) {
+    if (width == sizeof(int32_t)) {
+        if (value > INT32_MAX || value < INT32_MIN) return -1;
+        *(int32_t*)dst = (int32_t)value;
+    } else {
+        *(int64_t*)dst = value;
+    }
+    return 0;
+}
+
+#define IO_CHUNK 65536
+
+// Czyta count elementów o szerokości file_width do tablicy o elementach dst_width
+static int read_array(FILE *fp, void *dst, size_t dst_width, size_t file_width, int64_t count) {
+    if (dst_width == file_width) {
+        return fread(dst, file_width, (size_t)count, fp) == (size_t)count ? 0 : -1;
+    }
+
+    // Bufor na stercie - 512 KiB to za duzo na stos watku
+    char *buffer = malloc(IO_CHUNK * file_width);
+    if (!buffer) return -1;
+
+    char *out = dst;
+    int status = 0;
+    while (count > 0 && status == 0) {
+        size_t chunk = count < IO_CHUNK ? (size_t)count : IO_CHUNK;
+        if (fread(buffer, file_width, chunk, fp) != chunk) {
+            status = -1;
+            break;
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            if (store_value(out, dst_width, load_value(buffer + i * file_width, file_width)) != 0) {
+                status = -1;
+                break;
+            }
+            out += dst_width;
+        }
+        count -= chunk;
+    }
+    free(buffer);
+    return status;
+}
+
+// Zapisuje count elementów o szerokości src_width jako elementy file_width
+static int write_array(FILE *out, const void *src, size_t src_width, size_t file_width, int64_t count) {
+    if (src_width == file_width) {
+        return fwrite(src, file_width, (size_t)count, out) == (size_t)count ? 0 : -1;
+    }
+
+    char *buffer = malloc(IO_CHUNK * file_width);
+    if (!buffer) return -1;
+
+    const char *in = src;
+    int status = 0;
+    while (count > 0 && status == 0) {
+        size_t chunk = count < IO_CHUNK ? (size_t)count : IO_CHUNK;
+        for (size_t i = 0; i < chunk; i++) {
+            if (store_value(buffer + i * file_width, file_width, load_value(in, src_width)) != 0) {
+                status = -1;
+                break;
+            }
+            in += src_width;
+        }
+        if (status == 0 && fwrite(buffer, file_width, chunk, out) != chunk) status = -1;
+        count -= chunk;
+    }
+    free(buffer);
+    return status;
+}
+
+// Header: max_neighbors, xadj_size (nvtxs + 1), adjncy_size, num_components,
+// components_size - as 32-bit ints, or as 64-bit ints after GRAPH_BINARY_WIDE.
+// Checks the sizes against gidx_t/goff_t; returns 0, or -1 after reporting the error.
+static int read_binary_header(FILE *fp, const char *filename, int64_t header[5],
+                              size_t *idx_width, size_t *off_width) {
+    int32_t first;
+    if (fread(&first, sizeof(int32_t), 1, fp) != 1) {
+        fprintf(stderr, "Error: Failed to read max_neighbors from %s\n", filename);
+        return -1;
+    }
+
+    *idx_width = sizeof(int32_t);
+    *off_width = sizeof(int32_t);
+    int header_ok;
+
+    if (first == GRAPH_BINARY_WIDE) {
+        int32_t widths[2];
+        header_ok = fread(widths, sizeof(int32_t), 2, fp) == 2 &&
+                    (widths[0] == 4 || widths[0] == 8) && (widths[1] == 4 || widths[1] == 8) &&
+                    fread(header, sizeof(int64_t), 5, fp) == 5;
+        if (header_ok) {
+            *idx_width = widths[0];
+            *off_width = widths[1];
+        }
+    } else {
+        int32_t rest[4];
+        header_ok = fread(rest, sizeof(int32_t), 4, fp) == 4;
+        header[0] = first;
+        for (int i = 0; i < 4; i++) {
+            header[i + 1] = rest[i];
+        }
+    }
+
+    if (!header_ok) {
+        fprintf(stderr, "Error: Failed to read header from %s\n", filename);
+        return -1;
+    }
+
+    if (header[1] < 1 || header[2] < 0 || header[3] < 0 || header[4] < 0) {
+        fprintf(stderr, "Error: Invalid array sizes in header of %s\n", filename);
+        return -1;
+    }
+
+    if (header[0] > GIDX_MAX || header[1] - 1 > GIDX_MAX || header[2] > GOFF_MAX ||
+        header[3] + 1 > GIDX_MAX || header[4] > GIDX_MAX) {
+        fprintf(stderr, "Error: %s does not fit in %d-bit vertex ids / %d-bit offsets, rebuild with INDEX=64\n",
+                filename, (int)(sizeof(gidx_t) * 8), (int)(sizeof(goff_t) * 8));
+        return -1;
+    }
+    return 0;
+}
+
+int read_graph_binary_header(const char *filename, gidx_t *nvtxs, goff_t *edges, gidx_t *num_components) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    int64_t header[5];
+    size_t idx_width, off_width;
+    int status = read_binary_header(fp, filename, header, &idx_width, &off_width);
+    fclose(fp);
+    if (status != 0) return -1;
+
+    *nvtxs = (gidx_t)(header[1] - 1);
+    *edges = (goff_t)header[2];
+    *num_components = (gidx_t)header[3];
+    return 0;
+}
+
+Graph* read_graph_binary(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return NULL;
+    }
+
+    Graph *graph = calloc(1, sizeof(Graph));
+    if (!graph) {
+        fprintf(stderr, "Error: Unable to allocate graph for %s\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+
+    int64_t header[5];
+    size_t idx_width, off_width;
+    if (read_binary_header(fp, filename, header, &idx_width, &off_width) != 0) {
+        free(graph);
+        fclose(fp);
+        return NULL;
+    }
+
+    int64_t xadj_size = header[1];
+    int64_t adjncy_size = header[2];
+    int64_t components_size = header[4];
+
+    graph->max_neighbors = (gidx_t)header[0];
+    graph->nvtxs = (gidx_t)(xadj_size - 1);
+    graph->num_components = (gidx_t)header[3];
+
+    // Allocate memory for all arrays
+    graph->xadj = malloc((size_t)xadj_size * sizeof(goff_t));
+    graph->adjncy = malloc((size_t)adjncy_size * sizeof(gidx_t));
+    graph->component_ptr = malloc(((size_t)graph->num_components + 1) * sizeof(gidx_t));
+    graph->components = malloc((size_t)components_size * sizeof(gidx_t));
+    if (!graph->xadj || (adjncy_size > 0 && !graph->adjncy) || !graph->component_ptr ||
+        (components_size > 0 && !graph->components)) {
+        fprintf(stderr, "Error: Unable to allocate arrays for %s\n", filename);
+        free_graph(graph);
+        fclose(fp);
+        return NULL;
+    }
+
+    // Read xadj array
+    if (read_array(fp, graph->xadj, sizeof(goff_t), off_width, xadj_size) != 0) {
+        fprintf(stderr, "Error: Failed to read xadj from %s\n", filename);
+        free_graph(graph);
+        fclose(fp);
+        return NULL;
+    }
+
+    // Read adjncy array
+    if (read_array(fp, graph->adjncy, sizeof(gidx_t), idx_width, adjncy_size) != 0) {
+        fprintf(stderr, "Error: Failed to read adjncy from %s\n", filename);
+        free_graph(graph);
+        fclose(fp);
+        return NULL;
+    }
+
+    // Read component_ptr array
+    if (read_array(fp, graph->component_ptr, sizeof(gidx_t), idx_width, (int64_t)graph->num_components + 1) != 0) {
+        fprintf(stderr, "Error: Failed to read component_ptr from %s\n", filename);
+        free_graph(graph);
+        fclose(fp);
+        return NULL;
+    }
+
+    // Read components array
+    if (read_array(fp, graph->components, sizeof(gidx_t), idx_width, components_size) != 0) {
+        fprintf(stderr, "Error: Failed to read components from %s\n", filename);
+        free_graph(graph);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    return graph;
+}
+
+Graph* read_graph(const char *filename) {
+    if (detect_file_type(filename) == BINARY_MODE) {
+        return read_graph_binary(filename);
+    } else {
+        return read_graph_text(filename);
+    }
+}
+
+int write_graph_text(const char *filename, Graph *graph) {
+    FILE *out = fopen(filename, "w");
+    if (!out) {
+        perror("Error writing file");
+        return -1;
+    }
+
+    // Section 1
+    fprintf(out, "%" PRIgidx "\n", graph->max_neighbors);
+
+    // Section 2
+    for (goff_t i = 0; i < graph->xadj[graph->nvtxs]; i++) {
+        fprintf(out, "%" PRIgidx "%c", graph->adjncy[i],
+            (i == graph->xadj[graph->nvtxs]-1) ? '\n' : ';');
+    }
+
+    // Section 3
+    for (gidx_t i = 0; i <= graph->nvtxs; i++) {
+        fprintf(out, "%" PRIgoff "%c", graph->xadj[i],
+            (i == graph->nvtxs) ? '\n' : ';');
+    }
+
+    // Section 4
+    for (gidx_t i = 0; i < graph->component_ptr[graph->num_components]; i++) {
+        fprintf(out, "%" PRIgidx "%c", graph->components[i],
+            (i == graph->component_ptr[graph->num_components]-1) ? '\n' : ';');
+    }
+
+    // Section 5
+    for (gidx_t i = 0; i <= graph->num_components; i++) {
+        fprintf(out, "%" PRIgidx "%c", graph->component_ptr[i],
+            (i == graph->num_components) ? '\n' : ';');
+    }
+
+    int failed = ferror(out);
+    if (fclose(out) != 0 || failed) {
+        fprintf(stderr, "Error: Failed to write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int write_graph_binary_stream(FILE *out, Graph *graph) {
+    int64_t xadj_size = (int64_t)graph->nvtxs + 1;
+    int64_t adjncy_size = graph->xadj[graph->nvtxs];
+    int64_t components_size = graph->component_ptr[graph->num_components];
+    int64_t header[5] = {graph->max_neighbors, xadj_size, adjncy_size,
+                         graph->num_components, components_size};
+
+    // Grafy mieszczące się w 32 bitach zapisujemy w dotychczasowym formacie,
+    // większe w formacie z 64-bitowym nagłówkiem i szerokościami tablic
+    int wide = 0;
+    for (int i = 0; i < 5; i++) {
+        if (header[i] + 1 > INT32_MAX) wide = 1;
+    }
+    size_t idx_width = wide ? sizeof(gidx_t) : sizeof(int32_t);
+    size_t off_width = wide ? sizeof(goff_t) : sizeof(int32_t);
+
+    if (wide) {
+        int32_t prefix[3] = {GRAPH_BINARY_WIDE, (int32_t)idx_width, (int32_t)off_width};
+        fwrite(prefix, sizeof(int32_t), 3, out);
+        fwrite(header, sizeof(int64_t), 5, out);
+    } else {
+        for (int i = 0; i < 5; i++) {
+            int32_t value = (int32_t)header[i];
+            fwrite(&value, sizeof(int32_t), 1, out);
+        }
+    }
+
+    // Write arrays
+    if (write_array(out, graph->xadj, sizeof(goff_t), off_width, xadj_size) != 0 ||
+        write_array(out, graph->adjncy, sizeof(gidx_t), idx_width, adjncy_size) != 0 ||
+        write_array(out, graph->component_ptr, sizeof(gidx_t), idx_width, (int64_t)graph->num_components + 1) != 0 ||
+        write_array(out, graph->components, sizeof(gidx_t), idx_width, components_size) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int write_graph_binary(const char *filename, Graph *graph) {
+    FILE *out = fopen(filename, "wb");
+    if (!out) {
+        perror("Error writing binary file");
+        return -1;
+    }
+
+    int failed = write_graph_binary_stream(out, graph) != 0 || ferror(out);
+    if (fclose(out) != 0 || failed) {
+        fprintf(stderr, "Error: Failed to write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int write_graph(const char *filename, Graph *graph, const char *format) {
+    if (format && strcmp(format, "binary") == 0) {
+        return write_graph_binary(filename, graph);
+    } else {
+        return write_graph_text(filename, graph);
+    }
+}
+
+void free_graph(Graph *graph) {
+    if (graph) {
+        if (graph->adjncy) free(graph->adjncy);
+        if (graph->xadj) free(graph->xadj);
+        if (graph->components) free(graph->components);
+        if (graph->component_ptr) free(graph->component_ptr);
+        free(graph);
+    }
+}
+
+idx_t* read_parts(const char *filename, gidx_t nvtxs, int num_parts) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return NULL;
+    }
+
+    idx_t *parts = malloc((size_t)nvtxs * sizeof(idx_t));
+    if (!parts) {
+        fprintf(stderr, "Error: Unable to allocate parts for %s\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+
+    // Numery partycji rozdzielone ';' lub białymi znakami
+    gidx_t count = 0;
+    long long value;
+    int c;
+    while (count < nvtxs) {
+        while ((c = fgetc(fp)) == ';' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+        }
+        if (c == EOF) break;
+        ungetc(c, fp);
+        if (fscanf(fp, "%lld", &value) != 1 || value < 0 || value >= num_parts) {
+            fprintf(stderr, "Error: Invalid part number for vertex %" PRIgidx " in %s\n", count, filename);
+            free(parts);
+            fclose(fp);
+            return NULL;
+        }
+        parts[count++] = (idx_t)value;
+    }
+    fclose(fp);
+
+    if (count != nvtxs) {
+        fprintf(stderr, "Error: %s has %" PRIgidx " part numbers, expected %" PRIgidx "\n", filename, count, nvtxs);
+        free(parts);
+        return NULL;
+    }
+    return parts;
+}
+
+int write_idx_array(const char *filename, idx_t *values, gidx_t count) {
+    FILE *out = fopen(filename, "w");
+    if (!out) {
+        perror("Error writing file");
+        return -1;
+    }
+
+    for (gidx_t i = 0; i < count; i++) {
+        fprintf(out, "%" PRIDX "%c", values[i], (i == count - 1) ? '\n' : ';');
+    }
+    if (count == 0) {
+        fputc('\n', out);
+    }
+
+    return fclose(out) == 0 ? 0 : -1;
+}
@@ -0,0 +1,30 @@
+#ifndef GRAPH_IO_H
+#define GRAPH_IO_H
+
+#include <stdio.h>
+#include "graph_partion.h"
+
+// Wynik detect_file_type
+#define TEXT_MODE 0
+#define BINARY_MODE 1
+
+gidx_t* parse_section(char *line, goff_t *size, int *overflow);
+goff_t* parse_offsets(char *line, goff_t *size, int *overflow);
+int detect_file_type(const char *filename);
+Graph* read_graph_text(const char *filename);
+Graph* read_graph_binary(const char *filename);
+// Tylko nagłówek pliku binarnego: rozmiary bez wczytywania tablic
+int read_graph_binary_header(const char *filename, gidx_t *nvtxs, goff_t *edges, gidx_t *num_components);
+Graph* read_graph(const char *filename);
+int write_graph_text(const char *filename, Graph *graph);
+int write_graph_binary_stream(FILE *out, Graph *graph);
+int write_graph_binary(const char *filename, Graph *graph);
+int write_graph(const char *filename, Graph *graph, const char *format);
+void free_graph(Graph *graph);
+
+// Przypisanie wierzchołków do partycji w formacie jednej sekcji .csrrg
+idx_t* read_parts(const char *filename, gidx_t nvtxs, int num_parts);
+// Tablica idx_t (przypisanie do partycji, permutacja) jako jedna sekcja .csrrg
+int write_idx_array(const char *filename, idx_t *values, gidx_t count);
+
+#endif
@@ -1,44 +1,95 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <metis.h>
 #include "graph_partion.h"
 
-idx_t* Graph_parts(Graph* Origin_Graph, int partions_count, float error_margin, int* deleted_edges)
+// METIS 5.1 trzyma stan generatora losowego (GKlib) w zmiennych globalnych
+// procesu, a każde wywołanie ustawia go od nowa z ziarna. Równoległe wywołania
+// z kilku wątków przestawiałyby sobie nawzajem ziarna, więc wszystkie wywołania
+// METIS w obrębie procesu są szeregowane; równoległość prób zapewniają procesy
+// potomne (Graph_parts_multi).
+static pthread_mutex_t metis_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int metis_shares_graph(void)
 {
-    real_t ubvec = error_margin;
-    idx_t nvtxs = Origin_Graph->nvtxs;    // liczba wierzchołków
-    idx_t ncon = 1;                       // constraints (METIS wymaga)
+    return sizeof(idx_t) == sizeof(gidx_t) && sizeof(idx_t) == sizeof(goff_t);
+}
 
-    // Tworzenie kopii danych grafu do formatu METIS
-    idx_t *xadj = (idx_t*)malloc((nvtxs + 1) * sizeof(idx_t));
-    idx_t total_edges = Origin_Graph->xadj[nvtxs];
-    idx_t *adjncy = (idx_t*)malloc(total_edges * sizeof(idx_t));
-    
-    if (!xadj || !adjncy) {
+// Tworzenie kopii danych grafu do formatu METIS. Zwraca -1, gdy graf nie mieści
+// się w idx_t (METIS zbudowany z IDXTYPEWIDTH=32 przy dużym grafie).
+static int graph_to_metis(Graph* Origin_Graph, idx_t** xadj_out, idx_t** adjncy_out)
+{
+    gidx_t nvtxs = Origin_Graph->nvtxs;
+    goff_t total_edges = Origin_Graph->xadj[nvtxs];
+
+    if ((uint64_t)nvtxs + 1 > (uint64_t)IDX_MAX || (uint64_t)total_edges > (uint64_t)IDX_MAX) {
+        printf("Graf (%" PRIgidx " wierzchołków, %" PRIgoff " krawędzi) nie mieści się w idx_t METIS (%d bitów)\n",
+               nvtxs, total_edges, (int)(sizeof(idx_t) * 8));
+        return -1;
+    }
+
+    // Przy zgodnych szerokościach typów METIS korzysta bezpośrednio z tablic grafu
+    if (metis_shares_graph()) {
+        *xadj_out = (idx_t*)Origin_Graph->xadj;
+        *adjncy_out = (idx_t*)Origin_Graph->adjncy;
+        return 0;
+    }
+
+    idx_t *xadj = (idx_t*)malloc(((size_t)nvtxs + 1) * sizeof(idx_t));
+    idx_t *adjncy = (idx_t*)malloc((size_t)total_edges * sizeof(idx_t));
+
+    if (!xadj || (!adjncy && total_edges > 0)) {
         printf("Błąd alokacji pamięci w Graph_parts\n");
         if (xadj) free(xadj);
         if (adjncy) free(adjncy);
-        return NULL;
+        return -1;
     }
-    
+
     // Kopiowanie danych
-    for (idx_t i = 0; i <= nvtxs; i++) {
-        xadj[i] = Origin_Graph->xadj[i];
+    for (gidx_t i = 0; i <= nvtxs; i++) {
+        xadj[i] = (idx_t)Origin_Graph->xadj[i];
     }
-    
-    for (idx_t i = 0; i < total_edges; i++) {
-        adjncy[i] = Origin_Graph->adjncy[i];
+
+    for (goff_t i = 0; i < total_edges; i++) {
+        adjncy[i] = (idx_t)Origin_Graph->adjncy[i];
+    }
+
+    *xadj_out = xadj;
+    *adjncy_out = adjncy;
+    return 0;
+}
+
+// Zwolnienie kopii z graph_to_metis (o ile nie są to tablice samego grafu)
+static void free_metis_copy(Graph* Origin_Graph, idx_t* xadj, idx_t* adjncy)
+{
+    if (xadj != (idx_t*)Origin_Graph->xadj) free(xadj);
+    if (adjncy != (idx_t*)Origin_Graph->adjncy) free(adjncy);
+}
+
+idx_t* Graph_parts(Graph* Origin_Graph, int partions_count, float error_margin, goff_t* deleted_edges)
+{
+    real_t ubvec = error_margin;
+    idx_t nvtxs = Origin_Graph->nvtxs;    // liczba wierzchołków
+    idx_t ncon = 1;                       // constraints (METIS wymaga)
+
+    idx_t *xadj, *adjncy;
+    if (graph_to_metis(Origin_Graph, &xadj, &adjncy) != 0) {
+        return NULL;
     }
 
     idx_t nparts = partions_count;         // liczba partycji
     idx_t objval;                          // funkcja celu (wynik)
-    idx_t *part = (idx_t*)malloc(nvtxs * sizeof(idx_t));   // wynikowe partycje
+    idx_t *part = (idx_t*)malloc((size_t)nvtxs * sizeof(idx_t));   // wynikowe partycje
 
     if (!part) {
         printf("Błąd alokacji pamięci dla tablicy part\n");
-        free(xadj);
-        free(adjncy);
+        free_metis_copy(Origin_Graph, xadj, adjncy);
         return NULL;
     }
 
@@ -48,16 +99,17 @@ idx_t* Graph_parts(Graph* Origin_Graph, int partions_count, float error_margin,
     }
 
     // Wywołanie funkcji 
+    pthread_mutex_lock(&metis_lock);
     int status = METIS_PartGraphRecursive(&nvtxs, &ncon, xadj, adjncy,
                                        NULL, NULL, NULL, &nparts,
                                        NULL, &ubvec, NULL, &objval, part);
+    pthread_mutex_unlock(&metis_lock);
     
     // Zapisanie liczby usuniętych krawędzi
     *deleted_edges = objval;
     
     // Zwolnienie tymczasowych kopii
-    free(xadj);
-    free(adjncy);
+    free_metis_copy(Origin_Graph, xadj, adjncy);
     
     if (status == METIS_OK) {
         printf("Partycjonowanie zakończone sukcesem.\n");
@@ -70,323 +122,720 @@ idx_t* Graph_parts(Graph* Origin_Graph, int partions_count, float error_margin,
     return part;
 }
 
-Graph** graph_partition(Graph* Origin_Graph, idx_t* parts, int partions, float error_margin) {
-    int nvtxs = Origin_Graph->nvtxs;
-    int *xadj = Origin_Graph->xadj;
-    int *adjncy = Origin_Graph->adjncy;
-    int *components = Origin_Graph->components;
-    int *component_ptr = Origin_Graph->component_ptr;
+idx_t max_part_load(idx_t nvtxs, idx_t nparts, float error_margin)
+{
+    idx_t limit = (idx_t)(error_margin * (double)nvtxs / nparts);
+    idx_t ceil_avg = (nvtxs + nparts - 1) / nparts;
+    return limit < ceil_avg ? ceil_avg : limit;
+}
 
-    // Tworzymy tablicę wynikową
-    Graph** New_Graphs = (Graph**)malloc(partions * sizeof(Graph*));
-    if (!New_Graphs) {
-        printf("Unable to allocate Graph**\n");
-        return NULL;
+// Liczba wierzchołków w najliczniejszej partycji
+static idx_t heaviest_part(const idx_t* part, idx_t nvtxs, idx_t nparts, idx_t* load)
+{
+    for (idx_t p = 0; p < nparts; p++) {
+        load[p] = 0;
+    }
+    for (idx_t v = 0; v < nvtxs; v++) {
+        load[part[v]]++;
     }
+    idx_t max = 0;
+    for (idx_t p = 0; p < nparts; p++) {
+        if (load[p] > max) max = load[p];
+    }
+    return max;
+}
 
-    // Policz liczbę wierzchołków w każdej partycji
-    int* vertex_count = (int*)calloc(partions, sizeof(int));
-    if (!vertex_count) {
-        printf("Unable to allocate vertex_count\n");
-        free(New_Graphs);
-        return NULL;
+// Czy wynik (objval, heaviest) jest lepszy od dotychczasowego najlepszego
+static int seed_result_better(idx_t objval, idx_t heaviest, idx_t best_objval, idx_t best_heaviest, idx_t max_load)
+{
+    int balanced = heaviest <= max_load;
+    int best_balanced = best_heaviest <= max_load;
+
+    if (balanced != best_balanced) return balanced;
+    if (balanced) return objval < best_objval;
+    // Żaden nie spełnia marginesu - wybieramy mniej niezbalansowany
+    if (heaviest != best_heaviest) return heaviest < best_heaviest;
+    return objval < best_objval;
+}
+
+// Próba 0 używa domyślnego ziarna METIS (-1), kolejne ziaren 1, 2, ...
+static idx_t attempt_seed(int attempt)
+{
+    return attempt == 0 ? -1 : attempt;
+}
+
+// Najlepszy wynik jednego wykonawcy prób, w pamięci współdzielonej z procesami
+// potomnymi; zaraz za nagłówkiem leży tablica part o długości nvtxs
+typedef struct {
+    int found;
+    int attempt;
+    idx_t objval;
+    idx_t heaviest;
+} SeedSlot;
+
+typedef struct {
+    idx_t nvtxs;
+    idx_t *xadj;
+    idx_t *adjncy;
+    idx_t nparts;
+    real_t ubvec;
+    idx_t max_load;
+    int seeds_count;
+    int *next_attempt;      // wspólny licznik prób (pamięć współdzielona)
+    size_t slot_bytes;
+    char *slots;
+} SeedRun;
+
+static SeedSlot* seed_slot(SeedRun* run, int worker)
+{
+    return (SeedSlot*)(run->slots + (size_t)worker * run->slot_bytes);
+}
+
+// Pobiera kolejne próby ze wspólnego licznika i zapisuje najlepszy wynik w
+// slocie wykonawcy. Zwraca -1 przy braku pamięci.
+static int seed_worker_run(SeedRun* run, int worker)
+{
+    SeedSlot* slot = seed_slot(run, worker);
+    idx_t *best_part = (idx_t*)(slot + 1);
+    idx_t *part = (idx_t*)malloc((size_t)run->nvtxs * sizeof(idx_t));
+    idx_t *load = (idx_t*)malloc(run->nparts * sizeof(idx_t));
+    if (!part || !load) {
+        printf("Błąd alokacji pamięci dla próby partycjonowania\n");
+        free(part);
+        free(load);
+        return -1;
     }
-    
-    for (int i = 0; i < nvtxs; i++) {
-        if (parts[i] < 0 || parts[i] >= partions) {
-            printf("Invalid part number for vertex %d: %d\n", i, parts[i]);
-            free(New_Graphs);
-            free(vertex_count);
-            return NULL;
+
+    idx_t options[METIS_NOPTIONS];
+    METIS_SetDefaultOptions(options);
+
+    for (;;) {
+        int attempt = __atomic_fetch_add(run->next_attempt, 1, __ATOMIC_RELAXED);
+        if (attempt >= run->seeds_count) break;
+
+        idx_t nvtxs = run->nvtxs;
+        idx_t ncon = 1;
+        idx_t nparts = run->nparts;
+        real_t ubvec = run->ubvec;
+        idx_t objval;
+        options[METIS_OPTION_SEED] = attempt_seed(attempt);
+
+        pthread_mutex_lock(&metis_lock);
+        int status = METIS_PartGraphRecursive(&nvtxs, &ncon, run->xadj, run->adjncy,
+                                           NULL, NULL, NULL, &nparts,
+                                           NULL, &ubvec, options, &objval, part);
+        pthread_mutex_unlock(&metis_lock);
+        if (status != METIS_OK) {
+            printf("Błąd partycjonowania METIS (ziarno %" PRIDX "), kod: %d\n", attempt_seed(attempt), status);
+            continue;
+        }
+
+        idx_t heaviest = heaviest_part(part, run->nvtxs, run->nparts, load);
+        if (!slot->found || seed_result_better(objval, heaviest, slot->objval, slot->heaviest, run->max_load)) {
+            memcpy(best_part, part, (size_t)run->nvtxs * sizeof(idx_t));
+            slot->objval = objval;
+            slot->heaviest = heaviest;
+            slot->attempt = attempt;
+            slot->found = 1;
         }
-        vertex_count[parts[i]]++;
     }
 
-    // Mapowanie oryginalnych indeksów wierzchołków na nowe indeksy w partycjach
-    int** vertex_map = (int**)malloc(partions * sizeof(int*));
-    int** reverse_map = (int**)malloc(partions * sizeof(int*));
-    
-    if (!vertex_map || !reverse_map) {
-        printf("Unable to allocate mapping arrays\n");
-        free(New_Graphs);
-        free(vertex_count);
-        if (vertex_map) free(vertex_map);
-        if (reverse_map) free(reverse_map);
+    free(part);
+    free(load);
+    return 0;
+}
+
+idx_t* Graph_parts_multi(Graph* Origin_Graph, int partions_count, float error_margin, int seeds_count, int max_parallel, goff_t* deleted_edges)
+{
+    if (seeds_count <= 1) {
+        return Graph_parts(Origin_Graph, partions_count, error_margin, deleted_edges);
+    }
+
+    idx_t nvtxs = Origin_Graph->nvtxs;
+
+    // Jedna kopia danych grafu w formacie METIS, dziedziczona przez procesy potomne
+    idx_t *xadj, *adjncy;
+    if (graph_to_metis(Origin_Graph, &xadj, &adjncy) != 0) {
         return NULL;
     }
-    
-    for (int i = 0; i < partions; i++) {
-        vertex_map[i] = (int*)malloc(nvtxs * sizeof(int));
-        reverse_map[i] = (int*)malloc(vertex_count[i] * sizeof(int));
-        
-        if (!vertex_map[i] || !reverse_map[i]) {
-            printf("Unable to allocate mapping arrays for partition %d\n", i);
-            for (int j = 0; j <= i; j++) {
-                if (vertex_map[j]) free(vertex_map[j]);
-                if (reverse_map[j]) free(reverse_map[j]);
+
+    // Nie uruchamiamy więcej procesów niż jest prób, rdzeni ani niż pozwala max_parallel
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers_count = max_parallel > 1 ? max_parallel : 1;
+    if (workers_count > seeds_count) workers_count = seeds_count;
+    if (cpus > 0 && workers_count > cpus) workers_count = (int)cpus;
+
+    SeedRun run;
+    run.nvtxs = nvtxs;
+    run.xadj = xadj;
+    run.adjncy = adjncy;
+    run.nparts = partions_count;
+    run.ubvec = error_margin;
+    run.max_load = max_part_load(nvtxs, partions_count, error_margin);
+    run.seeds_count = seeds_count;
+    // Licznik prób na początku obszaru, sloty wyrównane do 64 bajtów
+    run.slot_bytes = (sizeof(SeedSlot) + (size_t)nvtxs * sizeof(idx_t) + 63) & ~(size_t)63;
+    size_t shared_bytes = 64 + (size_t)workers_count * run.slot_bytes;
+    void* shared = mmap(NULL, shared_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        printf("Błąd alokacji pamięci współdzielonej dla prób partycjonowania\n");
+        free_metis_copy(Origin_Graph, xadj, adjncy);
+        return NULL;
+    }
+    run.next_attempt = (int*)shared;
+    run.slots = (char*)shared + 64;
+    *run.next_attempt = 0;
+    for (int w = 0; w < workers_count; w++) {
+        seed_slot(&run, w)->found = 0;
+    }
+
+    // Wykonawca 0 to bieżący proces, pozostali to procesy potomne: każdy ma
+    // własny stan generatora METIS, więc próby są niezależne i powtarzalne
+    pid_t* children = (pid_t*)calloc(workers_count, sizeof(pid_t));
+    int forked = 0;
+    if (children) {
+        fflush(stdout);
+        for (int w = 1; w < workers_count; w++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                int status = seed_worker_run(&run, w);
+                fflush(stdout);
+                _exit(status == 0 ? 0 : 1);
             }
-            free(vertex_map);
-            free(reverse_map);
-            free(New_Graphs);
-            free(vertex_count);
-            return NULL;
-        }
-        
-        int idx = 0;
-        for (int v = 0; v < nvtxs; v++) {
-            if (parts[v] == i) {
-                vertex_map[i][v] = idx;
-                reverse_map[i][idx] = v;
-                idx++;
-            } else {
-                vertex_map[i][v] = -1;  // -1 oznacza, że wierzchołek nie należy do tej partycji
+            if (pid < 0) {
+                printf("Nie udało się uruchomić procesu prób (%d z %d działa), pozostałe próby liczy bieżący proces\n",
+                       forked + 1, workers_count);
+                break;
             }
+            children[w] = pid;
+            forked++;
         }
     }
 
-    // Policzenie liczby krawędzi wewnętrznych dla każdej partycji
-    int* edge_count = (int*)calloc(partions, sizeof(int));
-    if (!edge_count) {
-        printf("Unable to allocate edge_count\n");
-        free(New_Graphs);
-        free(vertex_count);
-        for (int i = 0; i < partions; i++) {
-            free(vertex_map[i]);
-            free(reverse_map[i]);
+    seed_worker_run(&run, 0);
+
+    for (int w = 1; w <= forked; w++) {
+        int wstatus;
+        while (waitpid(children[w], &wstatus, 0) < 0 && errno == EINTR) {
+        }
+        // Wynik procesu, który nie zakończył się poprawnie, pomijamy
+        if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+            seed_slot(&run, w)->found = 0;
         }
-        free(vertex_map);
-        free(reverse_map);
-        return NULL;
     }
+    free(children);
+    free_metis_copy(Origin_Graph, xadj, adjncy);
 
-    for (int v = 0; v < nvtxs; v++) {
-        int part_v = parts[v];
-        for (int e = xadj[v]; e < xadj[v + 1]; e++) {
-            int u = adjncy[e];
-            if (u < nvtxs && parts[u] == part_v) {  // Dodane sprawdzenie u < nvtxs
-                edge_count[part_v]++;
-            }
+    // Wybór najlepszego wyniku; przy remisie wygrywa wcześniejsza próba, żeby
+    // wynik nie zależał od podziału prób między procesy
+    SeedSlot* best = NULL;
+    for (int w = 0; w < workers_count; w++) {
+        SeedSlot* slot = seed_slot(&run, w);
+        if (!slot->found) continue;
+        if (!best || seed_result_better(slot->objval, slot->heaviest, best->objval, best->heaviest, run.max_load) ||
+            (!seed_result_better(best->objval, best->heaviest, slot->objval, slot->heaviest, run.max_load) &&
+             slot->attempt < best->attempt)) {
+            best = slot;
         }
     }
 
-    // Teraz alokujemy strukturę Graph dla każdej partycji
-    for (int i = 0; i < partions; i++) {
-        New_Graphs[i] = (Graph*)malloc(sizeof(Graph));
-        if (!New_Graphs[i]) {
-            printf("Unable to allocate Graph %d\n", i);
-            for (int j = 0; j < i; j++) {
-                free(New_Graphs[j]->adjncy);
-                free(New_Graphs[j]->xadj);
-                free(New_Graphs[j]->components);
-                free(New_Graphs[j]->component_ptr);
-                free(New_Graphs[j]);
-            }
-            free(New_Graphs);
-            free(vertex_count);
-            free(edge_count);
-            for (int j = 0; j < partions; j++) {
-                free(vertex_map[j]);
-                free(reverse_map[j]);
-            }
-            free(vertex_map);
-            free(reverse_map);
-            return NULL;
+    idx_t *part = NULL;
+    if (best) {
+        part = (idx_t*)malloc((size_t)nvtxs * sizeof(idx_t));
+        if (!part) {
+            printf("Błąd alokacji pamięci dla tablicy part\n");
+        } else {
+            memcpy(part, best + 1, (size_t)nvtxs * sizeof(idx_t));
+            *deleted_edges = best->objval;
+            printf("Partycjonowanie zakończone sukcesem (najlepsze ziarno %" PRIDX " z %d, cięcie %" PRIDX ", największa partycja %" PRIDX "/%" PRIDX "%s).\n",
+                   attempt_seed(best->attempt), seeds_count, best->objval,
+                   best->heaviest, run.max_load,
+                   best->heaviest <= run.max_load ? "" : " - margines przekroczony");
         }
+    } else {
+        printf("Błąd partycjonowania METIS dla wszystkich ziaren\n");
+    }
+
+    munmap(shared, shared_bytes);
+    return part;
+}
+
+static int compare_gidx(const void* a, const void* b)
+{
+    gidx_t x = *(const gidx_t*)a;
+    gidx_t y = *(const gidx_t*)b;
+    return x < y ? -1 : (x > y);
+}
 
-        New_Graphs[i]->nvtxs = vertex_count[i];
-        New_Graphs[i]->num_components = 0;  // Będziemy obliczać później
-        
-        // Wyznaczamy max_neighbors dla tej partycji
-        int max_n = 0;
-        for (int j = 0; j < vertex_count[i]; j++) {
-            int orig_v = reverse_map[i][j];
-            int degree = xadj[orig_v + 1] - xadj[orig_v];
-            if (degree > max_n) max_n = degree;
+// Uzupełnienie component_ptr i num_components partycji, której components
+// zawiera skopiowane etykiety składowych grafu. component_ptr to skumulowane
+// rozmiary składowych w kolejności rosnących etykiet. labels/sizes (o ile są)
+// to posortowane etykiety partycji i ich liczności wyznaczone wcześniej dla
+// wszystkich partycji naraz; bez nich etykiety partycji są sortowane.
+static void build_partition_components(Graph* g, const gidx_t* labels, const gidx_t* sizes, gidx_t count)
+{
+    gidx_t nvtxs = g->nvtxs;
+    gidx_t* sorted = NULL;
+
+    if (!labels) {
+        sorted = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+        if (nvtxs > 0 && !sorted) {
+            printf("Unable to allocate temporary components array\n");
+            // Kontynuujemy z pustą strukturą komponentów
+            g->num_components = 0;
+            g->component_ptr[0] = 0;
+            return;
         }
-        New_Graphs[i]->max_neighbors = max_n;
-
-        New_Graphs[i]->adjncy = (int*)malloc(edge_count[i] * sizeof(int));
-        New_Graphs[i]->xadj = (int*)malloc((vertex_count[i] + 1) * sizeof(int));
-        New_Graphs[i]->components = (int*)malloc(vertex_count[i] * sizeof(int));
-        New_Graphs[i]->component_ptr = (int*)malloc((vertex_count[i] + 1) * sizeof(int));
-
-        if (!New_Graphs[i]->adjncy || !New_Graphs[i]->xadj || 
-            !New_Graphs[i]->components || !New_Graphs[i]->component_ptr) {
-            printf("Unable to allocate arrays inside Graph partition %d.\n", i);
-            for (int j = 0; j <= i; j++) {
-                free(New_Graphs[j]->adjncy);
-                free(New_Graphs[j]->xadj);
-                free(New_Graphs[j]->components);
-                free(New_Graphs[j]->component_ptr);
-                free(New_Graphs[j]);
-            }
-            free(New_Graphs);
-            free(vertex_count);
-            free(edge_count);
-            for (int j = 0; j < partions; j++) {
-                free(vertex_map[j]);
-                free(reverse_map[j]);
+        if (nvtxs > 0) memcpy(sorted, g->components, (size_t)nvtxs * sizeof(gidx_t));
+        qsort(sorted, (size_t)nvtxs, sizeof(gidx_t), compare_gidx);
+    }
+
+    gidx_t num_components = 0;
+    g->component_ptr[0] = 0;
+    if (labels) {
+        for (gidx_t c = 0; c < count; c++) {
+            g->component_ptr[c + 1] = g->component_ptr[c] + sizes[c];
+        }
+        num_components = count;
+    } else {
+        // Po sortowaniu rozmiary składowych to długości serii równych etykiet
+        for (gidx_t i = 0; i < nvtxs; i++) {
+            if (i == 0 || sorted[i] != sorted[i - 1]) {
+                num_components++;
+                g->component_ptr[num_components] = g->component_ptr[num_components - 1];
             }
-            free(vertex_map);
-            free(reverse_map);
-            return NULL;
+            g->component_ptr[num_components]++;
         }
     }
+    g->num_components = num_components;
 
-    // Wypełnianie grafów
-    int* current_edge = (int*)calloc(partions, sizeof(int));
-    if (!current_edge) {
-        printf("Unable to allocate current_edge\n");
-        for (int i = 0; i < partions; i++) {
-            free(New_Graphs[i]->adjncy);
-            free(New_Graphs[i]->xadj);
-            free(New_Graphs[i]->components);
-            free(New_Graphs[i]->component_ptr);
-            free(New_Graphs[i]);
-        }
-        free(New_Graphs);
-        free(vertex_count);
-        free(edge_count);
-        for (int j = 0; j < partions; j++) {
-            free(vertex_map[j]);
-            free(reverse_map[j]);
+    free(sorted);
+}
+
+// Buduje graf jednej partycji. order[part_start[p]..part_start[p+1]) to
+// oryginalne wierzchołki partycji p, local_index[v] to indeks v w jego partycji.
+static Graph* extract_partition(Graph* Origin_Graph, idx_t* parts, int p,
+                                const gidx_t* order, const gidx_t* part_start, const gidx_t* local_index,
+                                const gidx_t* labels, const gidx_t* sizes, gidx_t labels_count)
+{
+    gidx_t nvtxs = Origin_Graph->nvtxs;
+    goff_t *xadj = Origin_Graph->xadj;
+    gidx_t *adjncy = Origin_Graph->adjncy;
+    gidx_t count = part_start[p + 1] - part_start[p];
+    const gidx_t *members = order + part_start[p];
+
+    // Policzenie liczby krawędzi wewnętrznych i max_neighbors
+    goff_t edges = 0;
+    gidx_t max_n = 0;
+    for (gidx_t j = 0; j < count; j++) {
+        gidx_t orig_v = members[j];
+        gidx_t degree = (gidx_t)(xadj[orig_v + 1] - xadj[orig_v]);
+        if (degree > max_n) max_n = degree;
+        for (goff_t e = xadj[orig_v]; e < xadj[orig_v + 1]; e++) {
+            gidx_t u = adjncy[e];
+            if (u < nvtxs && parts[u] == p) {
+                edges++;
+            }
         }
-        free(vertex_map);
-        free(reverse_map);
+    }
+
+    Graph* g = (Graph*)malloc(sizeof(Graph));
+    if (!g) {
+        printf("Unable to allocate Graph %d\n", p);
         return NULL;
     }
 
-    // Ustaw początkowe wartości xadj
-    for (int p = 0; p < partions; p++) {
-        New_Graphs[p]->xadj[0] = 0;
+    g->nvtxs = count;
+    g->num_components = 0;  // Obliczane niżej
+    g->max_neighbors = max_n;
+    g->adjncy = (gidx_t*)malloc((size_t)edges * sizeof(gidx_t));
+    g->xadj = (goff_t*)malloc(((size_t)count + 1) * sizeof(goff_t));
+    g->components = (gidx_t*)malloc((size_t)count * sizeof(gidx_t));
+    g->component_ptr = (gidx_t*)malloc(((size_t)count + 1) * sizeof(gidx_t));
+
+    if ((!g->adjncy && edges > 0) || !g->xadj ||
+        (!g->components && count > 0) || !g->component_ptr) {
+        printf("Unable to allocate arrays inside Graph partition %d.\n", p);
+        free(g->adjncy);
+        free(g->xadj);
+        free(g->components);
+        free(g->component_ptr);
+        free(g);
+        return NULL;
     }
 
     // Wypełnianie adjncy i xadj
-    for (int p = 0; p < partions; p++) {
-        for (int local_v = 0; local_v < vertex_count[p]; local_v++) {
-            int orig_v = reverse_map[p][local_v];
-            
-            // Dodawanie sąsiadów do tablicy adjncy i przeliczanie indeksów
-            for (int e = xadj[orig_v]; e < xadj[orig_v + 1]; e++) {
-                int orig_u = adjncy[e];
-                if (orig_u < nvtxs && parts[orig_u] == p) {
-                    // Przeliczamy indeks sąsiada na lokalny indeks w partycji
-                    int local_u = vertex_map[p][orig_u];
-                    New_Graphs[p]->adjncy[current_edge[p]++] = local_u;
-                }
+    goff_t current_edge = 0;
+    g->xadj[0] = 0;
+    for (gidx_t local_v = 0; local_v < count; local_v++) {
+        gidx_t orig_v = members[local_v];
+
+        // Dodawanie sąsiadów do tablicy adjncy i przeliczanie indeksów
+        for (goff_t e = xadj[orig_v]; e < xadj[orig_v + 1]; e++) {
+            gidx_t orig_u = adjncy[e];
+            if (orig_u < nvtxs && parts[orig_u] == p) {
+                g->adjncy[current_edge++] = local_index[orig_u];
             }
-            
-            // Ustawianie xadj dla następnego wierzchołka
-            New_Graphs[p]->xadj[local_v + 1] = current_edge[p];
-            
-            // Kopiowanie danych o komponentach
-            New_Graphs[p]->components[local_v] = components[orig_v];
         }
+
+        // Ustawianie xadj dla następnego wierzchołka
+        g->xadj[local_v + 1] = current_edge;
+
+        // Kopiowanie danych o komponentach
+        g->components[local_v] = Origin_Graph->components[orig_v];
+    }
+
+    build_partition_components(g, labels, sizes, labels_count);
+    return g;
+}
+
+int graph_partition_stream(Graph* Origin_Graph, idx_t* parts, int partions,
+                           partition_consumer consumer, void* ctx) {
+    gidx_t nvtxs = Origin_Graph->nvtxs;
+
+    // Sortowanie wierzchołków według partycji (zliczanie), dzięki czemu każda
+    // partycja jest budowana w czasie proporcjonalnym do jej rozmiaru
+    gidx_t* part_start = (gidx_t*)calloc(partions + 1, sizeof(gidx_t));
+    gidx_t* order = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+    gidx_t* local_index = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+    if (!part_start || !order || !local_index) {
+        printf("Unable to allocate mapping arrays\n");
+        free(part_start);
+        free(order);
+        free(local_index);
+        return -1;
+    }
+
+    for (gidx_t i = 0; i < nvtxs; i++) {
+        if (parts[i] < 0 || parts[i] >= partions) {
+            printf("Invalid part number for vertex %" PRIgidx ": %" PRIDX "\n", i, parts[i]);
+            free(part_start);
+            free(order);
+            free(local_index);
+            return -1;
+        }
+        part_start[parts[i] + 1]++;
     }
 
-    // Aktualizacja struktur komponentów dla każdej partycji
     for (int p = 0; p < partions; p++) {
-        // Tworzymy kopię tablicy components
-        int* tmp_components = (int*)malloc(vertex_count[p] * sizeof(int));
-        if (!tmp_components) {
-            printf("Unable to allocate temporary components array\n");
-            // Tutaj należałoby zwolnić wszystkie zaalokowane zasoby
-            // ale dla uproszczenia kontynuujemy z oryginalną strukturą komponentów
-        } else {
-            // Kopiujemy dane komponentów
-            for (int i = 0; i < vertex_count[p]; i++) {
-                tmp_components[i] = New_Graphs[p]->components[i];
-            }
-            
-            // Sortujemy komponenty (prosta implementacja)
-            // W rzeczywistej implementacji należałoby użyć efektywniejszej metody
-            int num_unique_components = 0;
-            int last_component = -1;
-            
-            for (int i = 0; i < vertex_count[p]; i++) {
-                int comp_found = 0;
-                for (int j = 0; j < num_unique_components; j++) {
-                    if (New_Graphs[p]->components[i] == tmp_components[j]) {
-                        comp_found = 1;
-                        break;
-                    }
+        part_start[p + 1] += part_start[p];
+    }
+
+    // Mapowanie oryginalnych indeksów wierzchołków na nowe indeksy w partycjach
+    for (gidx_t v = 0; v < nvtxs; v++) {
+        idx_t p = parts[v];
+        gidx_t pos = part_start[p]++;
+        order[pos] = v;
+        local_index[v] = pos;
+    }
+
+    // Przywrócenie początków partycji po przesunięciu w pętli powyżej
+    for (int p = partions; p > 0; p--) {
+        part_start[p] = part_start[p - 1];
+    }
+    part_start[0] = 0;
+
+    for (gidx_t v = 0; v < nvtxs; v++) {
+        local_index[v] -= part_start[parts[v]];
+    }
+
+    // Posortowane etykiety składowych każdej partycji i ich liczności, wyznaczone
+    // jednym przejściem po wierzchołkach uporządkowanych według etykiet (zliczanie),
+    // o ile zakres etykiet nie przekracza liczby wierzchołków. Etykiety partycji p
+    // leżą w labels[part_start[p] .. part_start[p] + labels_count[p]).
+    gidx_t* labels = NULL;
+    gidx_t* sizes = NULL;
+    gidx_t* labels_count = NULL;
+    if (nvtxs > 0) {
+        const gidx_t* components = Origin_Graph->components;
+        gidx_t min_label = components[0];
+        gidx_t max_label = components[0];
+        for (gidx_t v = 1; v < nvtxs; v++) {
+            if (components[v] < min_label) min_label = components[v];
+            if (components[v] > max_label) max_label = components[v];
+        }
+        if ((uint64_t)((int64_t)max_label - min_label) < (uint64_t)nvtxs) {
+            gidx_t range = max_label - min_label + 1;
+            gidx_t* label_start = (gidx_t*)calloc((size_t)range + 1, sizeof(gidx_t));
+            gidx_t* by_label = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+            labels = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+            sizes = (gidx_t*)malloc((size_t)nvtxs * sizeof(gidx_t));
+            labels_count = (gidx_t*)calloc(partions, sizeof(gidx_t));
+            if (label_start && by_label && labels && sizes && labels_count) {
+                for (gidx_t v = 0; v < nvtxs; v++) {
+                    label_start[components[v] - min_label + 1]++;
                 }
-                
-                if (!comp_found) {
-                    tmp_components[num_unique_components++] = New_Graphs[p]->components[i];
+                for (gidx_t l = 0; l < range; l++) {
+                    label_start[l + 1] += label_start[l];
                 }
-            }
-            
-            // Sortujemy unikalne komponenty
-            for (int i = 0; i < num_unique_components; i++) {
-                for (int j = i + 1; j < num_unique_components; j++) {
-                    if (tmp_components[i] > tmp_components[j]) {
-                        int temp = tmp_components[i];
-                        tmp_components[i] = tmp_components[j];
-                        tmp_components[j] = temp;
-                    }
+                for (gidx_t v = 0; v < nvtxs; v++) {
+                    by_label[label_start[components[v] - min_label]++] = v;
                 }
-            }
-            
-            // Aktualizujemy component_ptr
-            New_Graphs[p]->num_components = num_unique_components;
-            int current_pos = 0;
-            
-            for (int i = 0; i < num_unique_components; i++) {
-                New_Graphs[p]->component_ptr[i] = current_pos;
-                for (int j = 0; j < vertex_count[p]; j++) {
-                    if (New_Graphs[p]->components[j] == tmp_components[i]) {
-                        current_pos++;
+                for (gidx_t i = 0; i < nvtxs; i++) {
+                    gidx_t v = by_label[i];
+                    gidx_t base = part_start[parts[v]];
+                    gidx_t k = labels_count[parts[v]];
+                    if (k > 0 && labels[base + k - 1] == components[v]) {
+                        sizes[base + k - 1]++;
+                    } else {
+                        labels[base + k] = components[v];
+                        sizes[base + k] = 1;
+                        labels_count[parts[v]]++;
                     }
                 }
+            } else {
+                // Bez pamięci na wspólne tablice każda partycja sortuje swoje etykiety
+                free(labels);
+                free(sizes);
+                free(labels_count);
+                labels = sizes = labels_count = NULL;
             }
-            
-            New_Graphs[p]->component_ptr[num_unique_components] = vertex_count[p];
-            free(tmp_components);
+            free(label_start);
+            free(by_label);
+        }
+    }
+
+    int status = 0;
+    for (int p = 0; p < partions; p++) {
+        Graph* g = labels
+            ? extract_partition(Origin_Graph, parts, p, order, part_start, local_index,
+                                labels + part_start[p], sizes + part_start[p], labels_count[p])
+            : extract_partition(Origin_Graph, parts, p, order, part_start, local_index, NULL, NULL, 0);
+        if (!g) {
+            status = -1;
+            break;
+        }
+        // Konsument przejmuje własność grafu
+        if (consumer(g, p, ctx) != 0) {
+            status = -1;
+            break;
         }
     }
 
     // Sprzątanie tymczasowych tablic
-    free(vertex_count);
-    free(edge_count);
-    free(current_edge);
-    for (int i = 0; i < partions; i++) {
-        free(vertex_map[i]);
-        free(reverse_map[i]);
+    free(part_start);
+    free(order);
+    free(local_index);
+    free(labels);
+    free(sizes);
+    free(labels_count);
+
+    return status;
+}
+
+static int collect_partition(Graph* part_graph, int part_index, void* ctx)
+{
+    Graph** New_Graphs = (Graph**)ctx;
+    New_Graphs[part_index] = part_graph;
+    return 0;
+}
+
+Graph** graph_partition(Graph* Origin_Graph, idx_t* parts, int partions, float error_margin) {
+    (void)error_margin;
+
+    // Tworzymy tablicę wynikową
+    Graph** New_Graphs = (Graph**)calloc(partions, sizeof(Graph*));
+    if (!New_Graphs) {
+        printf("Unable to allocate Graph**\n");
+        return NULL;
+    }
+
+    if (graph_partition_stream(Origin_Graph, parts, partions, collect_partition, New_Graphs) != 0) {
+        for (int i = 0; i < partions; i++) {
+            if (New_Graphs[i]) {
+                free(New_Graphs[i]->adjncy);
+                free(New_Graphs[i]->xadj);
+                free(New_Graphs[i]->components);
+                free(New_Graphs[i]->component_ptr);
+                free(New_Graphs[i]);
+            }
+        }
+        free(New_Graphs);
+        return NULL;
     }
-    free(vertex_map);
-    free(reverse_map);
 
     return New_Graphs;
 }
 
+int compute_fill_ordering(Graph* graph, idx_t** perm_out, idx_t** iperm_out)
+{
+    gidx_t count = graph->nvtxs;
+    goff_t edges = graph->xadj[count];
+
+    if ((uint64_t)count + 1 > (uint64_t)IDX_MAX || (uint64_t)edges > (uint64_t)IDX_MAX) {
+        printf("Partycja (%" PRIgidx " wierzchołków) nie mieści się w idx_t METIS\n", count);
+        return -1;
+    }
+
+    // METIS_NodeND nie akceptuje pętli własnych, więc dane zawsze kopiujemy z filtrowaniem
+    idx_t *xadj = (idx_t*)malloc(((size_t)count + 1) * sizeof(idx_t));
+    idx_t *adjncy = (idx_t*)malloc((size_t)edges * sizeof(idx_t));
+    idx_t *perm = (idx_t*)malloc((size_t)count * sizeof(idx_t));
+    idx_t *iperm = (idx_t*)malloc((size_t)count * sizeof(idx_t));
+    if (!xadj || (edges > 0 && !adjncy) || (count > 0 && (!perm || !iperm))) {
+        printf("Błąd alokacji pamięci w compute_fill_ordering\n");
+        free(xadj);
+        free(adjncy);
+        free(perm);
+        free(iperm);
+        return -1;
+    }
+
+    idx_t current_edge = 0;
+    xadj[0] = 0;
+    for (gidx_t v = 0; v < count; v++) {
+        for (goff_t e = graph->xadj[v]; e < graph->xadj[v + 1]; e++) {
+            gidx_t u = graph->adjncy[e];
+            if (u >= 0 && u < count && u != v) {
+                adjncy[current_edge++] = (idx_t)u;
+            }
+        }
+        xadj[v + 1] = current_edge;
+    }
+
+    // NodeND również korzysta z globalnego generatora losowego METIS
+    int status = METIS_OK;
+    if (count > 0) {
+        idx_t nvtxs = count;
+        pthread_mutex_lock(&metis_lock);
+        status = METIS_NodeND(&nvtxs, xadj, adjncy, NULL, NULL, perm, iperm);
+        pthread_mutex_unlock(&metis_lock);
+    }
+    free(xadj);
+    free(adjncy);
+
+    if (status != METIS_OK) {
+        printf("Błąd METIS_NodeND, kod: %d\n", status);
+        free(perm);
+        free(iperm);
+        return -1;
+    }
+
+    *perm_out = perm;
+    *iperm_out = iperm;
+    return 0;
+}
+
+size_t graph_bytes(gidx_t nvtxs, goff_t edges, gidx_t num_components)
+{
+    return sizeof(Graph)
+        + ((size_t)nvtxs + 1) * sizeof(goff_t)
+        + (size_t)edges * sizeof(gidx_t)
+        + (size_t)nvtxs * sizeof(gidx_t)
+        + ((size_t)num_components + 1) * sizeof(gidx_t);
+}
+
+// Szacunek pamięci roboczej METIS: hierarchia zgrubnych grafów i tablice
+// pomocnicze to w praktyce kilka kopii grafu wejściowego
+#define METIS_WORKSPACE_FACTOR 4
+
+size_t estimate_partitioning_bytes(gidx_t nvtxs, goff_t edges, gidx_t num_components,
+                                   int partions_count, int parallel_attempts, int by_component)
+{
+    size_t input = graph_bytes(nvtxs, edges, num_components);
+    size_t metis_graph = ((size_t)nvtxs + 1 + (size_t)edges) * sizeof(idx_t);
+    size_t part = (size_t)nvtxs * sizeof(idx_t) + (size_t)partions_count * sizeof(idx_t);
+
+    // Równoległe próby z różnymi ziarnami mają własną pamięć roboczą i dwie tablice part
+    size_t attempts = parallel_attempts > 1 ? (size_t)parallel_attempts : 1;
+
+    size_t total = input
+        + (metis_shares_graph() ? 0 : metis_graph)
+        + attempts * (METIS_WORKSPACE_FACTOR * metis_graph + 2 * part)
+        + part;
+
+    // Tryb po składowych: uporządkowanie wierzchołków i podgrafy składowych
+    if (by_component) {
+        total += 2 * (size_t)nvtxs * sizeof(gidx_t) + input;
+    }
+    return total;
+}
+
+size_t estimate_extraction_bytes(gidx_t nvtxs, goff_t edges, gidx_t num_components, int partions_count)
+{
+    return graph_bytes(nvtxs, edges, num_components)
+        + (size_t)nvtxs * sizeof(idx_t)
+        + 6 * (size_t)nvtxs * sizeof(gidx_t)
+        + (2 * (size_t)partions_count + 1) * sizeof(gidx_t);
+}
+
+size_t ordering_bytes(gidx_t nvtxs, goff_t edges)
+{
+    size_t metis_graph = ((size_t)nvtxs + 1 + (size_t)edges) * sizeof(idx_t);
+    return (METIS_WORKSPACE_FACTOR + 1) * metis_graph + 2 * (size_t)nvtxs * sizeof(idx_t);
+}
+
+int partition_bytes(Graph* Origin_Graph, idx_t* parts, int partions, int with_ordering, size_t* bytes)
+{
+    gidx_t nvtxs = Origin_Graph->nvtxs;
+    gidx_t* vertex_count = (gidx_t*)calloc(partions, sizeof(gidx_t));
+    goff_t* edge_count = (goff_t*)calloc(partions, sizeof(goff_t));
+    if (!vertex_count || !edge_count) {
+        printf("Unable to allocate partition size counters\n");
+        free(vertex_count);
+        free(edge_count);
+        return -1;
+    }
+
+    for (gidx_t v = 0; v < nvtxs; v++) {
+        idx_t p = parts[v];
+        if (p < 0 || p >= partions) {
+            printf("Invalid part number for vertex %" PRIgidx ": %" PRIDX "\n", v, p);
+            free(vertex_count);
+            free(edge_count);
+            return -1;
+        }
+        vertex_count[p]++;
+        for (goff_t e = Origin_Graph->xadj[v]; e < Origin_Graph->xadj[v + 1]; e++) {
+            gidx_t u = Origin_Graph->adjncy[e];
+            if (u < nvtxs && parts[u] == p) {
+                edge_count[p]++;
+            }
+        }
+    }
+
+    // Liczba składowych partycji nie przekracza liczby jej wierzchołków; doliczamy
+    // też tymczasową tablicę używaną przy ich wyznaczaniu
+    for (int p = 0; p < partions; p++) {
+        bytes[p] = graph_bytes(vertex_count[p], edge_count[p], vertex_count[p])
+            + (size_t)vertex_count[p] * sizeof(gidx_t);
+        if (with_ordering) {
+            bytes[p] += ordering_bytes(vertex_count[p], edge_count[p]);
+        }
+    }
+
+    free(vertex_count);
+    free(edge_count);
+    return 0;
+}
+
 void print_graph_info(Graph* graph, const char* name) {
     printf("\n=== Graf %s ===\n", name);
-    printf("Liczba wierzchołków: %d\n", graph->nvtxs);
-    printf("Liczba komponentów: %d\n", graph->num_components);
-    printf("Max sąsiadów: %d\n", graph->max_neighbors);
+    printf("Liczba wierzchołków: %" PRIgidx "\n", graph->nvtxs);
+    printf("Liczba komponentów: %" PRIgidx "\n", graph->num_components);
+    printf("Max sąsiadów: %" PRIgidx "\n", graph->max_neighbors);
     
     printf("xadj: ");
-    for (int i = 0; i <= graph->nvtxs; i++) {
-        printf("%d ", graph->xadj[i]);
+    for (gidx_t i = 0; i <= graph->nvtxs; i++) {
+        printf("%" PRIgoff " ", graph->xadj[i]);
     }
     printf("\n");
     
     printf("adjncy: ");
-    for (int i = 0; i < graph->xadj[graph->nvtxs]; i++) {
-        printf("%d ", graph->adjncy[i]);
+    for (goff_t i = 0; i < graph->xadj[graph->nvtxs]; i++) {
+        printf("%" PRIgidx " ", graph->adjncy[i]);
     }
     printf("\n");
     
     printf("components: ");
-    for (int i = 0; i < graph->nvtxs; i++) {
-        printf("%d ", graph->components[i]);
+    for (gidx_t i = 0; i < graph->nvtxs; i++) {
+        printf("%" PRIgidx " ", graph->components[i]);
     }
     printf("\n");
     
     printf("component_ptr: ");
-    for (int i = 0; i <= graph->num_components; i++) {
-        printf("%d ", graph->component_ptr[i]);
+    for (gidx_t i = 0; i <= graph->num_components; i++) {
+        printf("%" PRIgidx " ", graph->component_ptr[i]);
     }
     printf("\n");
 }
@@ -2,24 +2,93 @@
 #define GRAPH_PARTION_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <metis.h>
 
+// Szerokość indeksów grafu wybierana przy kompilacji:
+//   domyślnie            - 32-bitowe wierzchołki i przesunięcia xadj
+//   -DGRAPH_INDEX64      - 64-bitowe wierzchołki i przesunięcia
+//   -DGRAPH_OFFSET64     - 32-bitowe wierzchołki, 64-bitowe przesunięcia xadj
+//                          (grafy z ponad 2^31 krawędziami, ale mniej niż 2^31 wierzchołkami)
+#if defined(GRAPH_INDEX64)
+typedef int64_t gidx_t;
+typedef int64_t goff_t;
+#define PRIgidx PRId64
+#define PRIgoff PRId64
+#define GIDX_MAX INT64_MAX
+#define GOFF_MAX INT64_MAX
+#elif defined(GRAPH_OFFSET64)
+typedef int32_t gidx_t;
+typedef int64_t goff_t;
+#define PRIgidx PRId32
+#define PRIgoff PRId64
+#define GIDX_MAX INT32_MAX
+#define GOFF_MAX INT64_MAX
+#else
+typedef int32_t gidx_t;
+typedef int32_t goff_t;
+#define PRIgidx PRId32
+#define PRIgoff PRId32
+#define GIDX_MAX INT32_MAX
+#define GOFF_MAX INT32_MAX
+#endif
+
 typedef struct {
-    int max_neighbors;
-    int *adjncy;
-    int *xadj;
-    int nvtxs;
-    int *components;
-    int *component_ptr;
-    int num_components;
+    gidx_t max_neighbors;
+    gidx_t *adjncy;
+    goff_t *xadj;
+    gidx_t nvtxs;
+    gidx_t *components;
+    gidx_t *component_ptr;
+    gidx_t num_components;
 } Graph;
 
-idx_t* Graph_parts(Graph* Origin_Graph, int partions_count, float error_margin, int* deleted_edges);
+// Pojedyncze wywołanie METIS w bieżącym procesie. Wszystkie wywołania METIS
+// w procesie są szeregowane, bo METIS trzyma stan generatora losowego globalnie.
+idx_t* Graph_parts(Graph* Origin_Graph, int partions_count, float error_margin, goff_t* deleted_edges);
+
+// Wykonuje seeds_count niezależnych prób METIS z różnymi ziarnami i zwraca
+// podział o najmniejszym cięciu spełniający error_margin. Próba 0 używa
+// domyślnego ziarna METIS, kolejne ziaren 1..seeds_count-1; wynik nie zależy
+// od liczby procesów. Przy max_parallel > 1 próby liczy do max_parallel procesów
+// (bieżący i potomne z fork()), co wolno robić tylko, gdy w procesie nie działają
+// inne wątki; przy max_parallel <= 1 próby liczone są po kolei w bieżącym wątku.
+idx_t* Graph_parts_multi(Graph* Origin_Graph, int partions_count, float error_margin, int seeds_count, int max_parallel, goff_t* deleted_edges);
+
+// Największa dopuszczalna liczba wierzchołków w jednej partycji dla danego marginesu
+idx_t max_part_load(idx_t nvtxs, idx_t nparts, float error_margin);
+
+// Wywoływana dla każdej partycji zaraz po jej zbudowaniu; przejmuje własność
+// part_graph. Niezerowy wynik przerywa wyodrębnianie kolejnych partycji.
+typedef int (*partition_consumer)(Graph* part_graph, int part_index, void* ctx);
+
+int graph_partition_stream(Graph* Origin_Graph, idx_t* parts, int partions, partition_consumer consumer, void* ctx);
 
 Graph** graph_partition(Graph* Origin_Graph, idx_t* parts, int partions, float error_margin);
 
+// Szacunki pamięci (w bajtach) dla trybu --max-memory
+size_t graph_bytes(gidx_t nvtxs, goff_t edges, gidx_t num_components);
+// Szczyt fazy partycjonowania: graf, kopie dla METIS, pamięć robocza
+// parallel_attempts równoległych prób; liczone z samych rozmiarów grafu,
+// więc można je wyznaczyć z nagłówka pliku przed wczytaniem tablic
+size_t estimate_partitioning_bytes(gidx_t nvtxs, goff_t edges, gidx_t num_components,
+                                   int partions_count, int parallel_attempts, int by_component);
+// Stała część fazy wyodrębniania: graf, tablica parts, mapowania wierzchołków
+size_t estimate_extraction_bytes(gidx_t nvtxs, goff_t edges, gidx_t num_components, int partions_count);
+// Pamięć wyznaczania uporządkowania (kopia dla METIS_NodeND, praca, perm/iperm)
+size_t ordering_bytes(gidx_t nvtxs, goff_t edges);
+// Rozmiar każdej partycji po wyodrębnieniu (opcjonalnie wraz z uporządkowaniem),
+// zanim zostanie zbudowana
+int partition_bytes(Graph* Origin_Graph, idx_t* parts, int partions, int with_ordering, size_t* bytes);
+
 int partition_graph_and_save(Graph* input_graph, int partions_count, float error_margin, const char* output_format);
 
+// Uporządkowanie zmniejszające wypełnienie (nested dissection, METIS_NodeND)
+// dla jednej partycji. Zwraca perm i iperm o długości graph->nvtxs.
+// Podobnie jak Graph_parts_multi liczy w procesie potomnym.
+int compute_fill_ordering(Graph* graph, idx_t** perm_out, idx_t** iperm_out);
+
 void print_graph_info(Graph* graph, const char* name);
 
 #endif
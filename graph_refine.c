@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <metis.h>
+#include "graph_refine.h"
+
+// Maksymalna liczba przebiegów; każdy przebieg ściśle zmniejsza cięcie
+#define REFINE_MAX_PASSES 16
+
+typedef struct {
+    gidx_t vertex;
+    idx_t target;
+    gidx_t gain;
+} RefineMove;
+
+typedef struct {
+    Graph* graph;
+    idx_t* parts;
+    int partions_count;
+    gidx_t begin;
+    gidx_t end;
+
+    // Wyniki wątku
+    goff_t cut;
+    RefineMove* moves;
+    gidx_t moves_count;
+    gidx_t moves_capacity;
+    int failed;
+    int running;
+} RefineWorker;
+
+// Najlepszy ruch wierzchołka v: partycja z największą liczbą sąsiadów.
+// conn to liczniki sąsiadów w partycjach (zerowane po użyciu), touched - lista
+// partycji z niezerowym licznikiem. Zwraca zysk (liczba sąsiadów w celu minus
+// liczba sąsiadów we własnej partycji) i dolicza krawędzie cięte do *cut.
+// Zysk równa się zmianie cięcia tylko przy symetrycznym sąsiedztwie.
+static gidx_t best_move(Graph* graph, idx_t* parts, gidx_t v, gidx_t* conn, idx_t* touched,
+                        idx_t* target, goff_t* cut)
+{
+    gidx_t nvtxs = graph->nvtxs;
+    idx_t own = parts[v];
+    int touched_count = 0;
+    gidx_t internal = 0;
+
+    for (goff_t e = graph->xadj[v]; e < graph->xadj[v + 1]; e++) {
+        gidx_t u = graph->adjncy[e];
+        if (u < 0 || u >= nvtxs || u == v) continue;
+        idx_t q = parts[u];
+        if (q == own) {
+            internal++;
+            continue;
+        }
+        if (conn[q]++ == 0) {
+            touched[touched_count++] = q;
+        }
+    }
+
+    gidx_t best = 0;
+    *target = own;
+    for (int i = 0; i < touched_count; i++) {
+        idx_t q = touched[i];
+        if (cut) *cut += conn[q];
+        if (conn[q] > best || (conn[q] == best && q < *target)) {
+            best = conn[q];
+            *target = q;
+        }
+        conn[q] = 0;
+    }
+    return best - internal;
+}
+
+static int push_move(RefineWorker* w, gidx_t v, idx_t target, gidx_t gain)
+{
+    if (w->moves_count == w->moves_capacity) {
+        gidx_t capacity = w->moves_capacity ? w->moves_capacity * 2 : 1024;
+        RefineMove* moves = realloc(w->moves, (size_t)capacity * sizeof(RefineMove));
+        if (!moves) return -1;
+        w->moves = moves;
+        w->moves_capacity = capacity;
+    }
+    w->moves[w->moves_count].vertex = v;
+    w->moves[w->moves_count].target = target;
+    w->moves[w->moves_count].gain = gain;
+    w->moves_count++;
+    return 0;
+}
+
+// Faza równoległa: cięcie i kandydaci do przeniesienia w zakresie wierzchołków
+static void* refine_scan(void* arg)
+{
+    RefineWorker* w = (RefineWorker*)arg;
+    gidx_t* conn = (gidx_t*)calloc(w->partions_count, sizeof(gidx_t));
+    idx_t* touched = (idx_t*)malloc(w->partions_count * sizeof(idx_t));
+    w->cut = 0;
+    w->moves_count = 0;
+
+    if (!conn || !touched) {
+        w->failed = 1;
+        free(conn);
+        free(touched);
+        return NULL;
+    }
+
+    for (gidx_t v = w->begin; v < w->end; v++) {
+        idx_t target;
+        gidx_t gain = best_move(w->graph, w->parts, v, conn, touched, &target, &w->cut);
+        if (gain > 0 && push_move(w, v, target, gain) != 0) {
+            w->failed = 1;
+            break;
+        }
+    }
+
+    free(conn);
+    free(touched);
+    return NULL;
+}
+
+// Uruchamia refine_scan na wszystkich wątkach; zwraca -1 przy błędzie
+static int run_scan(RefineWorker* workers, pthread_t* threads, int threads_count)
+{
+    for (int t = 0; t < threads_count; t++) {
+        if (pthread_create(&threads[t], NULL, refine_scan, &workers[t]) != 0) {
+            // Zakres, dla którego nie udało się uruchomić wątku, liczymy w bieżącym
+            workers[t].running = 0;
+            refine_scan(&workers[t]);
+        } else {
+            workers[t].running = 1;
+        }
+    }
+    int failed = 0;
+    for (int t = 0; t < threads_count; t++) {
+        if (workers[t].running) pthread_join(threads[t], NULL);
+        failed |= workers[t].failed;
+    }
+    return failed ? -1 : 0;
+}
+
+goff_t partition_edge_cut(Graph* graph, idx_t* parts)
+{
+    gidx_t nvtxs = graph->nvtxs;
+    goff_t cut = 0;
+    for (gidx_t v = 0; v < nvtxs; v++) {
+        for (goff_t e = graph->xadj[v]; e < graph->xadj[v + 1]; e++) {
+            gidx_t u = graph->adjncy[e];
+            if (u >= 0 && u < nvtxs && parts[u] != parts[v]) cut++;
+        }
+    }
+    // Sąsiedztwo jest symetryczne, więc każda cięta krawędź została policzona dwukrotnie
+    return cut / 2;
+}
+
+int refine_partition(Graph* graph, idx_t* parts, int partions_count, float error_margin,
+                     goff_t* cut_before, goff_t* cut_after)
+{
+    gidx_t nvtxs = graph->nvtxs;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads_count = cpus > 0 ? (int)cpus : 1;
+    if (threads_count > nvtxs) threads_count = nvtxs > 0 ? (int)nvtxs : 1;
+
+    RefineWorker* workers = (RefineWorker*)calloc(threads_count, sizeof(RefineWorker));
+    pthread_t* threads = (pthread_t*)malloc(threads_count * sizeof(pthread_t));
+    idx_t* load = (idx_t*)calloc(partions_count, sizeof(idx_t));
+    gidx_t* conn = (gidx_t*)calloc(partions_count, sizeof(gidx_t));
+    idx_t* touched = (idx_t*)malloc(partions_count * sizeof(idx_t));
+
+    // Zysk nie przekracza stopnia wierzchołka
+    gidx_t max_gain = 0;
+    for (gidx_t u = 0; u < nvtxs; u++) {
+        gidx_t degree = (gidx_t)(graph->xadj[u + 1] - graph->xadj[u]);
+        if (degree > max_gain) max_gain = degree;
+    }
+    gidx_t* bucket_count = (gidx_t*)calloc((size_t)max_gain + 1, sizeof(gidx_t));
+    if (!workers || !threads || !load || !conn || !touched || !bucket_count) {
+        printf("Błąd alokacji pamięci w refine_partition\n");
+        free(workers);
+        free(threads);
+        free(load);
+        free(conn);
+        free(touched);
+        free(bucket_count);
+        return -1;
+    }
+
+    for (gidx_t v = 0; v < nvtxs; v++) {
+        load[parts[v]]++;
+    }
+    idx_t max_load = max_part_load(nvtxs, partions_count, error_margin);
+
+    // Zakresy wierzchołków o zbliżonej liczbie krawędzi
+    goff_t total_edges = graph->xadj[nvtxs];
+    gidx_t v = 0;
+    for (int t = 0; t < threads_count; t++) {
+        goff_t edge_limit = (goff_t)((double)total_edges * (t + 1) / threads_count);
+        workers[t].graph = graph;
+        workers[t].parts = parts;
+        workers[t].partions_count = partions_count;
+        workers[t].begin = v;
+        while (v < nvtxs && (graph->xadj[v] < edge_limit || t == threads_count - 1)) {
+            v++;
+        }
+        workers[t].end = v;
+    }
+
+    int status = 0;
+    goff_t cut = -1;
+    gidx_t total_moved = 0;
+    int passes = 0;
+    RefineMove* sorted = NULL;
+
+    while (passes < REFINE_MAX_PASSES) {
+        if (run_scan(workers, threads, threads_count) != 0) {
+            printf("Błąd alokacji pamięci w wątkach refine_partition\n");
+            status = -1;
+            break;
+        }
+        passes++;
+
+        goff_t directed_cut = 0;
+        gidx_t candidates = 0;
+        for (int t = 0; t < threads_count; t++) {
+            directed_cut += workers[t].cut;
+            candidates += workers[t].moves_count;
+        }
+        // Jak w partition_edge_cut: przy symetrycznym sąsiedztwie każda krawędź liczona dwa razy
+        cut = directed_cut / 2;
+        if (passes == 1) *cut_before = cut;
+        if (candidates == 0) break;
+
+        // Kubełki zysków: kandydaci uporządkowani malejąco według zysku
+        RefineMove* grown = realloc(sorted, (size_t)candidates * sizeof(RefineMove));
+        if (!grown) {
+            printf("Błąd alokacji pamięci w refine_partition\n");
+            status = -1;
+            break;
+        }
+        sorted = grown;
+
+        memset(bucket_count, 0, ((size_t)max_gain + 1) * sizeof(gidx_t));
+        for (int t = 0; t < threads_count; t++) {
+            for (gidx_t i = 0; i < workers[t].moves_count; i++) {
+                bucket_count[workers[t].moves[i].gain]++;
+            }
+        }
+        gidx_t position = 0;
+        for (gidx_t g = max_gain; g >= 0; g--) {
+            gidx_t count = bucket_count[g];
+            bucket_count[g] = position;
+            position += count;
+        }
+        for (int t = 0; t < threads_count; t++) {
+            for (gidx_t i = 0; i < workers[t].moves_count; i++) {
+                sorted[bucket_count[workers[t].moves[i].gain]++] = workers[t].moves[i];
+            }
+        }
+
+        // Faza sekwencyjna: zysk jest liczony ponownie, bo sąsiedzi mogli się już
+        // przenieść; ruch jest wykonywany tylko przy dodatnim zysku i w granicach balansu
+        gidx_t moved = 0;
+        for (gidx_t i = 0; i < candidates; i++) {
+            gidx_t u = sorted[i].vertex;
+            idx_t own = parts[u];
+            idx_t target;
+            gidx_t gain = best_move(graph, parts, u, conn, touched, &target, NULL);
+            if (gain <= 0 || load[target] + 1 > max_load || load[own] <= 1) continue;
+
+            parts[u] = target;
+            load[own]--;
+            load[target]++;
+            moved++;
+        }
+
+        total_moved += moved;
+        if (moved == 0) break;
+    }
+
+    if (status == 0) {
+        // Po ostatnich ruchach cięcie z fazy równoległej jest nieaktualne
+        *cut_after = total_moved > 0 ? partition_edge_cut(graph, parts) : cut;
+        printf("Refinement: cięcie %" PRIgoff " -> %" PRIgoff " (%" PRIgidx " przeniesionych wierzchołków, %d przebiegów)\n",
+               *cut_before, *cut_after, total_moved, passes);
+    }
+
+    for (int t = 0; t < threads_count; t++) {
+        free(workers[t].moves);
+    }
+    free(workers);
+    free(threads);
+    free(load);
+    free(conn);
+    free(touched);
+    free(bucket_count);
+    free(sorted);
+    return status;
+}
@@ -0,0 +1,19 @@
+#ifndef GRAPH_REFINE_H
+#define GRAPH_REFINE_H
+
+#include "graph_partion.h"
+
+// Obie funkcje zakładają symetryczną listę sąsiedztwa (jak METIS): krawędź
+// {u, v} występuje w adjncy zarówno u, jak i v.
+
+// Liczba krawędzi łączących różne partycje (każda krawędź nieskierowana liczona raz)
+goff_t partition_edge_cut(Graph* graph, idx_t* parts);
+
+// Poprawia dowolne przypisanie parts w miejscu: wątki równolegle wyznaczają
+// ruchy wierzchołków brzegowych o dodatnim zysku, które są następnie
+// stosowane od największego zysku (kubełki zysków) z zachowaniem error_margin.
+// Zwraca 0 i cięcie przed/po w cut_before/cut_after, -1 przy błędzie.
+int refine_partition(Graph* graph, idx_t* parts, int partions_count, float error_margin,
+                     goff_t* cut_before, goff_t* cut_after);
+
+#endif
@@ -0,0 +1,652 @@
+// struct ucred (SO_PEERCRED)
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "graph_partion.h"
+#include "graph_components.h"
+#include "graph_refine.h"
+#include "graph_io.h"
+#include "graph_server.h"
+
+#define MAX_PATH_LEN 4096
+// Limit czasu (w sekundach) na dosłanie reszty rozpoczętego żądania
+#define SERVER_READ_TIMEOUT 30
+
+typedef struct GraphEntry {
+    uint32_t id;
+    Graph* graph;
+    int refs;
+    int unloaded;
+    int components_computed;
+    struct GraphEntry* next;
+} GraphEntry;
+
+typedef struct {
+    int listen_fd;
+    int stopping;
+    uint32_t next_graph_id;
+    unsigned shm_counter;
+    GraphEntry* graphs;
+
+    // Budzenie pętli poll() po zwróceniu połączenia lub przy zamykaniu
+    int wake_pipe[2];
+
+    // Połączenia z gotowym żądaniem, czekające na wątek
+    int* ready;
+    int ready_head;
+    int ready_count;
+
+    // Połączenia obsłużone przez wątki, do ponownego obserwowania przez poll()
+    int* returned;
+    int returned_count;
+
+    // Wszystkie otwarte połączenia klientów (bezczynne, gotowe i obsługiwane)
+    int connections;
+
+    // Wątki dostępne dla jednego żądania; pula wątków serwera już zajmuje rdzenie
+    int request_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+} Server;
+
+static int read_full(int fd, void* buffer, size_t size)
+{
+    char* p = buffer;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void* buffer, size_t size)
+{
+    const char* p = buffer;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+// Pobiera graf o danym id i zwiększa licznik odwołań; NULL gdy nie istnieje
+static GraphEntry* acquire_graph(Server* server, uint32_t id)
+{
+    pthread_mutex_lock(&server->lock);
+    GraphEntry* entry = server->graphs;
+    while (entry && (entry->id != id || entry->unloaded)) {
+        entry = entry->next;
+    }
+    if (entry) entry->refs++;
+    pthread_mutex_unlock(&server->lock);
+    return entry;
+}
+
+// Zwalnia odwołanie; graf oznaczony do usunięcia jest zwalniany przez ostatniego użytkownika
+static void release_graph(Server* server, GraphEntry* entry)
+{
+    pthread_mutex_lock(&server->lock);
+    entry->refs--;
+    int remove = entry->unloaded && entry->refs == 0;
+    if (remove) {
+        GraphEntry** link = &server->graphs;
+        while (*link != entry) link = &(*link)->next;
+        *link = entry->next;
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (remove) {
+        free_graph(entry->graph);
+        free(entry);
+    }
+}
+
+// Tworzy nowy obiekt pamięci współdzielonej o unikalnej nazwie
+static int create_shm(Server* server, char* name, size_t name_size)
+{
+    pthread_mutex_lock(&server->lock);
+    unsigned counter = server->shm_counter++;
+    pthread_mutex_unlock(&server->lock);
+
+    snprintf(name, name_size, "/partitioner-%d-%u", (int)getpid(), counter);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        perror("shm_open");
+    }
+    return fd;
+}
+
+static void handle_load(Server* server, int fd, ServerRequest* request, ServerResponse* response)
+{
+    if (request->path_len == 0 || request->path_len > MAX_PATH_LEN) {
+        response->status = SERVER_ERROR_REQUEST;
+        return;
+    }
+
+    char path[MAX_PATH_LEN + 1];
+    if (read_full(fd, path, request->path_len) != 0) {
+        response->status = SERVER_ERROR_REQUEST;
+        return;
+    }
+    path[request->path_len] = '\0';
+
+    Graph* graph = read_graph(path);
+    if (!graph) {
+        response->status = SERVER_ERROR_LOAD;
+        return;
+    }
+
+    int computed = (request->flags & SERVER_FLAG_COMPUTE_COMPONENTS) != 0;
+    if (computed && compute_components(graph) != 0) {
+        free_graph(graph);
+        response->status = SERVER_ERROR_MEMORY;
+        return;
+    }
+
+    GraphEntry* entry = calloc(1, sizeof(GraphEntry));
+    if (!entry) {
+        free_graph(graph);
+        response->status = SERVER_ERROR_MEMORY;
+        return;
+    }
+    entry->graph = graph;
+    entry->components_computed = computed;
+
+    pthread_mutex_lock(&server->lock);
+    entry->id = ++server->next_graph_id;
+    entry->next = server->graphs;
+    server->graphs = entry;
+    pthread_mutex_unlock(&server->lock);
+
+    printf("Wczytano graf %u z %s (%" PRIgidx " wierzchołków)\n", entry->id, path, graph->nvtxs);
+    response->graph_id = entry->id;
+    response->nvtxs = graph->nvtxs;
+}
+
+static void handle_unload(Server* server, ServerRequest* request, ServerResponse* response)
+{
+    GraphEntry* entry = acquire_graph(server, request->graph_id);
+    if (!entry) {
+        response->status = SERVER_ERROR_NO_GRAPH;
+        return;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    entry->unloaded = 1;
+    pthread_mutex_unlock(&server->lock);
+    release_graph(server, entry);
+}
+
+// Partycjonuje graf według parametrów żądania
+static idx_t* partition_request(Server* server, GraphEntry* entry, ServerRequest* request, ServerResponse* response)
+{
+    Graph* graph = entry->graph;
+    int by_component = (request->flags & SERVER_FLAG_BY_COMPONENT) != 0;
+
+    if (request->num_parts < 1 || request->num_parts > graph->nvtxs ||
+        request->error_margin < 0 || request->error_margin > 100 ||
+        (by_component && !entry->components_computed)) {
+        response->status = SERVER_ERROR_REQUEST;
+        return NULL;
+    }
+
+    float margine = 1.0 + request->error_margin / 100;
+    int seeds = request->seeds > 1 ? request->seeds : 1;
+    goff_t deleted_edges = 0;
+
+    // Serwer jest wielowątkowy, więc próby liczone są bez procesów potomnych
+    idx_t* parts = by_component
+        ? Graph_parts_by_component(graph, request->num_parts, margine, seeds, server->request_threads, &deleted_edges)
+        : Graph_parts_multi(graph, request->num_parts, margine, seeds, 1, &deleted_edges);
+    if (!parts) {
+        response->status = SERVER_ERROR_PARTITION;
+        return NULL;
+    }
+
+    if (request->flags & SERVER_FLAG_REFINE) {
+        goff_t cut_before;
+        if (refine_partition(graph, parts, request->num_parts, margine, &cut_before, &deleted_edges) != 0) {
+            free(parts);
+            response->status = SERVER_ERROR_MEMORY;
+            return NULL;
+        }
+    }
+
+    response->nvtxs = graph->nvtxs;
+    response->edgecut = deleted_edges;
+    return parts;
+}
+
+static void handle_partition(Server* server, ServerRequest* request, ServerResponse* response)
+{
+    GraphEntry* entry = acquire_graph(server, request->graph_id);
+    if (!entry) {
+        response->status = SERVER_ERROR_NO_GRAPH;
+        return;
+    }
+
+    idx_t* parts = partition_request(server, entry, request, response);
+    if (!parts) {
+        release_graph(server, entry);
+        return;
+    }
+
+    size_t size = (size_t)entry->graph->nvtxs * sizeof(idx_t);
+    release_graph(server, entry);
+
+    int shm_fd = create_shm(server, response->shm_name, sizeof(response->shm_name));
+    if (shm_fd < 0 || write_full(shm_fd, parts, size) != 0) {
+        if (shm_fd >= 0) {
+            close(shm_fd);
+            shm_unlink(response->shm_name);
+        }
+        response->shm_name[0] = '\0';
+        response->status = SERVER_ERROR_MEMORY;
+        free(parts);
+        return;
+    }
+    close(shm_fd);
+    free(parts);
+
+    response->shm_size = size;
+}
+
+typedef struct {
+    FILE* out;
+    int64_t* offsets;
+    int failed;
+} ExtractSink;
+
+// Każda partycja jest zapisywana do pamięci współdzielonej zaraz po zbudowaniu
+static int extract_to_shm(Graph* part_graph, int part_index, void* ctx)
+{
+    ExtractSink* sink = ctx;
+    sink->offsets[part_index] = ftello(sink->out);
+    if (write_graph_binary_stream(sink->out, part_graph) != 0) {
+        sink->failed = 1;
+    }
+    free_graph(part_graph);
+    return sink->failed ? -1 : 0;
+}
+
+static void handle_extract(Server* server, ServerRequest* request, ServerResponse* response)
+{
+    GraphEntry* entry = acquire_graph(server, request->graph_id);
+    if (!entry) {
+        response->status = SERVER_ERROR_NO_GRAPH;
+        return;
+    }
+
+    idx_t* parts = partition_request(server, entry, request, response);
+    if (!parts) {
+        release_graph(server, entry);
+        return;
+    }
+
+    int num_parts = request->num_parts;
+    ExtractSink sink = {NULL, calloc((size_t)num_parts + 1, sizeof(int64_t)), 0};
+    int shm_fd = sink.offsets ? create_shm(server, response->shm_name, sizeof(response->shm_name)) : -1;
+    if (shm_fd >= 0) {
+        sink.out = fdopen(shm_fd, "w+b");
+        if (!sink.out) close(shm_fd);
+    }
+
+    int status = -1;
+    if (sink.out && fseeko(sink.out, (off_t)((num_parts + 1) * sizeof(int64_t)), SEEK_SET) == 0) {
+        status = graph_partition_stream(entry->graph, parts, num_parts, extract_to_shm, &sink);
+    }
+    release_graph(server, entry);
+    free(parts);
+
+    if (status == 0) {
+        sink.offsets[num_parts] = ftello(sink.out);
+        if (fseeko(sink.out, 0, SEEK_SET) != 0 ||
+            fwrite(sink.offsets, sizeof(int64_t), (size_t)num_parts + 1, sink.out) != (size_t)num_parts + 1) {
+            status = -1;
+        }
+    }
+    if (sink.out && fclose(sink.out) != 0) {
+        status = -1;
+    }
+
+    if (status != 0) {
+        if (shm_fd >= 0) shm_unlink(response->shm_name);
+        response->shm_name[0] = '\0';
+        response->status = SERVER_ERROR_MEMORY;
+    } else {
+        response->shm_size = (uint64_t)sink.offsets[num_parts];
+    }
+    free(sink.offsets);
+}
+
+static void wake_poll(Server* server)
+{
+    char byte = 0;
+    while (write(server->wake_pipe[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+}
+
+// Zatrzymuje serwer: budzi pętlę poll() i wątki czekające na żądania
+static void stop_server(Server* server)
+{
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_cond_broadcast(&server->not_empty);
+    pthread_mutex_unlock(&server->lock);
+    wake_poll(server);
+}
+
+// Obsługuje jedno żądanie z połączenia. Zwraca 1, gdy połączenie ma pozostać
+// otwarte, 0 gdy należy je zamknąć.
+static int serve_request(Server* server, int fd)
+{
+    ServerRequest request;
+    if (read_full(fd, &request, sizeof(request)) != 0) {
+        return 0;
+    }
+
+    ServerResponse response;
+    memset(&response, 0, sizeof(response));
+    response.status = SERVER_OK;
+    response.graph_id = request.graph_id;
+    response.idx_width = sizeof(idx_t);
+
+    switch (request.op) {
+    case SERVER_OP_LOAD:
+        handle_load(server, fd, &request, &response);
+        break;
+    case SERVER_OP_UNLOAD:
+        handle_unload(server, &request, &response);
+        break;
+    case SERVER_OP_PARTITION:
+        handle_partition(server, &request, &response);
+        break;
+    case SERVER_OP_EXTRACT:
+        handle_extract(server, &request, &response);
+        break;
+    case SERVER_OP_SHUTDOWN:
+        break;
+    default:
+        response.status = SERVER_ERROR_REQUEST;
+        break;
+    }
+
+    if (write_full(fd, &response, sizeof(response)) != 0) {
+        // Klient zniknął - nikt nie odbierze pamięci współdzielonej
+        if (response.shm_name[0]) shm_unlink(response.shm_name);
+        return 0;
+    }
+    if (request.op == SERVER_OP_SHUTDOWN) {
+        stop_server(server);
+        return 0;
+    }
+    // Nieprzeczytana ścieżka rozsynchronizowałaby strumień żądań
+    if (request.op == SERVER_OP_LOAD && response.status == SERVER_ERROR_REQUEST) {
+        return 0;
+    }
+    return 1;
+}
+
+static void* server_worker_run(void* arg)
+{
+    Server* server = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        while (server->ready_count == 0 && !server->stopping) {
+            pthread_cond_wait(&server->not_empty, &server->lock);
+        }
+        if (server->stopping) {
+            pthread_mutex_unlock(&server->lock);
+            break;
+        }
+        int fd = server->ready[server->ready_head];
+        server->ready_head = (server->ready_head + 1) % SERVER_MAX_CONNECTIONS;
+        server->ready_count--;
+        pthread_mutex_unlock(&server->lock);
+
+        int keep = serve_request(server, fd);
+
+        pthread_mutex_lock(&server->lock);
+        if (keep && !server->stopping) {
+            server->returned[server->returned_count++] = fd;
+        } else {
+            close(fd);
+            server->connections--;
+        }
+        pthread_mutex_unlock(&server->lock);
+        if (keep) wake_poll(server);
+    }
+    return NULL;
+}
+
+// Odrzuca połączenie, odpowiadając podanym statusem
+static void reject_connection(int fd, int32_t status)
+{
+    ServerResponse response;
+    memset(&response, 0, sizeof(response));
+    response.status = status;
+    response.idx_width = sizeof(idx_t);
+    write_full(fd, &response, sizeof(response));
+    close(fd);
+}
+
+// Żądania mogą wysyłać tylko procesy tego samego użytkownika, bo LOAD czyta
+// dowolne pliki z uprawnieniami serwera
+static int peer_allowed(int fd)
+{
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return 0;
+    }
+    return credentials.uid == geteuid() || credentials.uid == 0;
+}
+
+int run_graph_server(const char* socket_path, int workers_count)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    // Zerwane połączenie ma kończyć się błędem zapisu, a nie sygnałem
+    signal(SIGPIPE, SIG_IGN);
+
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.wake_pipe[0] = server.wake_pipe[1] = -1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    server.request_threads = cpus > workers_count ? (int)(cpus / workers_count) : 1;
+    server.ready = malloc(SERVER_MAX_CONNECTIONS * sizeof(int));
+    server.returned = malloc(SERVER_MAX_CONNECTIONS * sizeof(int));
+    // Gniazdo nasłuchujące, potok budzący i bezczynne połączenia
+    struct pollfd* fds = malloc((SERVER_MAX_CONNECTIONS + 2) * sizeof(struct pollfd));
+    pthread_t* threads = malloc(workers_count * sizeof(pthread_t));
+    if (!server.ready || !server.returned || !fds || !threads) {
+        fprintf(stderr, "Error: Unable to allocate server state\n");
+        free(server.ready);
+        free(server.returned);
+        free(fds);
+        free(threads);
+        return -1;
+    }
+
+    // Gniazdo tworzone od razu z prawami 0600, żeby inni użytkownicy nie mogli
+    // się z nim połączyć nawet przez chwilę
+    server.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path);
+    mode_t old_umask = umask(0177);
+    int bound = server.listen_fd >= 0 &&
+                bind(server.listen_fd, (struct sockaddr*)&address, sizeof(address)) == 0;
+    umask(old_umask);
+    if (!bound ||
+        listen(server.listen_fd, 64) != 0 ||
+        pipe(server.wake_pipe) != 0) {
+        perror("Error: Cannot listen on socket");
+        if (server.listen_fd >= 0) close(server.listen_fd);
+        free(server.ready);
+        free(server.returned);
+        free(fds);
+        free(threads);
+        return -1;
+    }
+    fcntl(server.wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(server.wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.not_empty, NULL);
+
+    int started = 0;
+    for (int i = 0; i < workers_count; i++) {
+        if (pthread_create(&threads[i], NULL, server_worker_run, &server) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Error: Unable to start server threads\n");
+    } else {
+        printf("Serwer nasłuchuje na %s (%d wątków)\n", socket_path, started);
+        fflush(stdout);
+    }
+
+    // Wątki dostają pojedyncze żądania, więc bezczynni klienci nie blokują puli
+    fds[0].fd = server.listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = server.wake_pipe[0];
+    fds[1].events = POLLIN;
+    int idle_count = 0;
+
+    while (started > 0) {
+        if (poll(fds, 2 + idle_count, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: poll");
+            break;
+        }
+
+        pthread_mutex_lock(&server.lock);
+        if (server.stopping) {
+            pthread_mutex_unlock(&server.lock);
+            break;
+        }
+
+        // Połączenia z nadchodzącym żądaniem (lub zamknięte) przekazujemy wątkom
+        for (int i = 2 + idle_count - 1; i >= 2; i--) {
+            if (!fds[i].revents) continue;
+            server.ready[(server.ready_head + server.ready_count) % SERVER_MAX_CONNECTIONS] = fds[i].fd;
+            server.ready_count++;
+            fds[i] = fds[2 + idle_count - 1];
+            idle_count--;
+            pthread_cond_signal(&server.not_empty);
+        }
+
+        if (fds[1].revents) {
+            char buffer[64];
+            while (read(server.wake_pipe[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        for (int i = 0; i < server.returned_count; i++) {
+            fds[2 + idle_count].fd = server.returned[i];
+            fds[2 + idle_count].events = POLLIN;
+            fds[2 + idle_count].revents = 0;
+            idle_count++;
+        }
+        server.returned_count = 0;
+
+        int accepting = fds[0].revents != 0;
+        pthread_mutex_unlock(&server.lock);
+
+        if (accepting) {
+            int fd = accept(server.listen_fd, NULL, NULL);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) continue;
+                perror("Error: accept");
+                break;
+            }
+
+            // Klient, który nie dośle żądania, nie może zablokować wątku na stałe
+            struct timeval timeout = { SERVER_READ_TIMEOUT, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            if (!peer_allowed(fd)) {
+                reject_connection(fd, SERVER_ERROR_DENIED);
+                continue;
+            }
+
+            pthread_mutex_lock(&server.lock);
+            int accepted = server.connections < SERVER_MAX_CONNECTIONS;
+            if (accepted) server.connections++;
+            pthread_mutex_unlock(&server.lock);
+
+            if (accepted) {
+                fds[2 + idle_count].fd = fd;
+                fds[2 + idle_count].events = POLLIN;
+                fds[2 + idle_count].revents = 0;
+                idle_count++;
+            } else {
+                reject_connection(fd, SERVER_ERROR_BUSY);
+            }
+        }
+    }
+
+    stop_server(&server);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Połączenia, których nikt nie zdążył obsłużyć
+    for (int i = 2; i < 2 + idle_count; i++) {
+        close(fds[i].fd);
+    }
+    while (server.ready_count > 0) {
+        close(server.ready[server.ready_head]);
+        server.ready_head = (server.ready_head + 1) % SERVER_MAX_CONNECTIONS;
+        server.ready_count--;
+    }
+    for (int i = 0; i < server.returned_count; i++) {
+        close(server.returned[i]);
+    }
+
+    close(server.listen_fd);
+    close(server.wake_pipe[0]);
+    close(server.wake_pipe[1]);
+    unlink(socket_path);
+
+    while (server.graphs) {
+        GraphEntry* next = server.graphs->next;
+        free_graph(server.graphs->graph);
+        free(server.graphs);
+        server.graphs = next;
+    }
+
+    pthread_mutex_destroy(&server.lock);
+    pthread_cond_destroy(&server.not_empty);
+    free(server.ready);
+    free(server.returned);
+    free(fds);
+    free(threads);
+    return 0;
+}
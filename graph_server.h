@@ -0,0 +1,72 @@
+#ifndef GRAPH_SERVER_H
+#define GRAPH_SERVER_H
+
+#include <stdint.h>
+
+// Protokół serwera partycjonowania (gniazdo domeny Unix, SOCK_STREAM).
+// Klient wysyła ServerRequest (dla SERVER_OP_LOAD zaraz po nim path_len bajtów
+// ścieżki bez '\0') i otrzymuje ServerResponse. W jednym połączeniu można
+// wysłać dowolnie wiele żądań; każde żądanie trafia do wolnego wątku osobno, więc
+// bezczynne połączenia nie zajmują wątków. Ponad SERVER_MAX_CONNECTIONS otwartych
+// połączeń nowy klient od razu dostaje odpowiedź SERVER_ERROR_BUSY, po czym
+// połączenie jest zamykane. Gniazdo ma prawa 0600, a połączenia od procesów
+// innego użytkownika (poza rootem) dostają SERVER_ERROR_DENIED i są zamykane.
+// Wyniki PARTITION i EXTRACT trafiają do pamięci współdzielonej shm_name
+// o rozmiarze shm_size; klient mapuje ją przez shm_open/mmap i sam wywołuje
+// shm_unlink.
+//
+//   PARTITION: nvtxs liczb całkowitych ze znakiem o szerokości idx_width bajtów
+//              (idx_t METIS, 4 lub 8) - numer partycji każdego wierzchołka
+//   EXTRACT:   int64_t offsets[num_parts + 1], a pod offsets[i] partycja i
+//              w binarnym formacie pliku .bin
+#define SERVER_OP_LOAD 1
+#define SERVER_OP_UNLOAD 2
+#define SERVER_OP_PARTITION 3
+#define SERVER_OP_EXTRACT 4
+#define SERVER_OP_SHUTDOWN 5
+
+// LOAD: wyznacz spójne składowe zamiast ufać plikowi
+#define SERVER_FLAG_COMPUTE_COMPONENTS 1
+// PARTITION/EXTRACT: partycjonowanie po składowych (graf wczytany z COMPUTE_COMPONENTS)
+#define SERVER_FLAG_BY_COMPONENT 2
+// PARTITION/EXTRACT: poprawa przypisania przez refine_partition
+#define SERVER_FLAG_REFINE 4
+
+#define SERVER_OK 0
+#define SERVER_ERROR_REQUEST -1
+#define SERVER_ERROR_NO_GRAPH -2
+#define SERVER_ERROR_LOAD -3
+#define SERVER_ERROR_PARTITION -4
+#define SERVER_ERROR_MEMORY -5
+#define SERVER_ERROR_BUSY -6
+#define SERVER_ERROR_DENIED -7
+
+#define SERVER_MAX_CONNECTIONS 1024
+
+typedef struct {
+    uint32_t op;
+    uint32_t graph_id;
+    int32_t num_parts;
+    float error_margin;     // w procentach, jak w linii poleceń
+    int32_t seeds;
+    uint32_t flags;
+    uint32_t path_len;
+    uint32_t reserved;
+} ServerRequest;
+
+typedef struct {
+    int32_t status;
+    uint32_t graph_id;
+    int64_t nvtxs;
+    int64_t edgecut;
+    uint64_t shm_size;
+    uint32_t idx_width;     // bajty na element wyniku PARTITION
+    uint32_t reserved;
+    char shm_name[64];
+} ServerResponse;
+
+// Obsługuje żądania na socket_path aż do SERVER_OP_SHUTDOWN; workers_count
+// wątków wykonuje żądania równolegle. Zwraca 0 po poprawnym zamknięciu.
+int run_graph_server(const char* socket_path, int workers_count);
+
+#endif
@@ -1,314 +1,349 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "graph_partion.h"
-
-#define MAX_LINE 1000000
-#define TEXT_MODE 0
-#define BINARY_MODE 1
+#include "graph_components.h"
+#include "graph_refine.h"
+#include "graph_io.h"
+#include "graph_server.h"
 
 // Function declarations
-int* parse_section(char *line, int *size);
-int detect_file_type(const char *filename);
-Graph* read_graph_text(const char *filename);
-Graph* read_graph_binary(const char *filename);
-Graph* read_graph(const char *filename);
-void write_graph_text(const char *filename, Graph *graph);
-void write_graph_binary(const char *filename, Graph *graph);
-void write_graph(const char *filename, Graph *graph, const char *format);
-void free_graph(Graph *graph);
 void print_usage(const char *program_name);
-
-int* parse_section(char *line, int *size) {
-    int *arr = NULL;
-    int capacity = 0;
-    char *token = strtok(line, ";");
-
-    while (token) {
-        if (*size >= capacity) {
-            capacity = capacity ? capacity * 2 : 1;
-            arr = realloc(arr, capacity * sizeof(int));
-        }
-        arr[(*size)++] = atoi(token);
-        token = strtok(NULL, ";");
-    }
-    return arr;
+size_t parse_memory_size(const char *text);
+const char *format_memory_size(size_t bytes, char *buffer, size_t size);
+void print_memory_budget_error(size_t max_memory, size_t partitioning, size_t extraction);
+int write_queue_push(Graph *part_graph, int part_index, void *ctx);
+void *write_queue_worker(void *arg);
+
+// Rozmiar z opcjonalnym przyrostkiem K, M lub G (potęgi 1024); 0 przy błędzie
+size_t parse_memory_size(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || value <= 0) return 0;
+
+    switch (*end) {
+    case 'k': case 'K': value *= 1024.0; end++; break;
+    case 'm': case 'M': value *= 1024.0 * 1024; end++; break;
+    case 'g': case 'G': value *= 1024.0 * 1024 * 1024; end++; break;
+    default: break;
+    }
+    if (*end == 'b' || *end == 'B') end++;
+    if (*end != '\0') return 0;
+    return (size_t)value;
 }
 
-int detect_file_type(const char *filename) {
-    char *ext = strrchr(filename, '.');
-    if (ext && strcmp(ext, ".bin") == 0) {
-        return BINARY_MODE;
+// Rozmiar w jednostce dobranej do wielkości (B, KB, MB, GB)
+const char *format_memory_size(size_t bytes, char *buffer, size_t size) {
+    if (bytes < 1024) {
+        snprintf(buffer, size, "%zu B", bytes);
+    } else if (bytes < 1024 * 1024) {
+        snprintf(buffer, size, "%.1f KB", bytes / 1024.0);
+    } else if (bytes < 1024UL * 1024 * 1024) {
+        snprintf(buffer, size, "%.1f MB", bytes / 1048576.0);
+    } else {
+        snprintf(buffer, size, "%.1f GB", bytes / 1073741824.0);
     }
-    return TEXT_MODE;
+    return buffer;
 }
 
-Graph* read_graph_text(const char *filename) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot open file %s\n", filename);
-        return NULL;
-    }
-
-    Graph *graph = malloc(sizeof(Graph));
-    char line[MAX_LINE];
-
-    // Section 1: max_neighbors
-    fgets(line, MAX_LINE, fp);
-    graph->max_neighbors = atoi(line);
-
-    // Section 2: adjncy
-    int adjncy_size = 0;
-    fgets(line, MAX_LINE, fp);
-    graph->adjncy = parse_section(line, &adjncy_size);
-
-    // Section 3: xadj
-    int xadj_size = 0;
-    fgets(line, MAX_LINE, fp);
-    graph->xadj = parse_section(line, &xadj_size);
-    graph->nvtxs = xadj_size - 1;
-
-    // Section 4: components
-    int components_size = 0;
-    fgets(line, MAX_LINE, fp);
-    graph->components = parse_section(line, &components_size);
-
-    // Section 5: component_ptr
-    int component_ptr_size = 0;
-    fgets(line, MAX_LINE, fp);
-    graph->component_ptr = parse_section(line, &component_ptr_size);
-    graph->num_components = component_ptr_size - 1;
-
-    fclose(fp);
-    return graph;
+void print_memory_budget_error(size_t max_memory, size_t partitioning, size_t extraction) {
+    char budget_text[32], partitioning_text[32], extraction_text[32];
+    fprintf(stderr, "Error: --max-memory %s is too small, estimated peak: partitioning %s, extraction at least %s\n",
+            format_memory_size(max_memory, budget_text, sizeof(budget_text)),
+            format_memory_size(partitioning, partitioning_text, sizeof(partitioning_text)),
+            format_memory_size(extraction, extraction_text, sizeof(extraction_text)));
 }
 
-Graph* read_graph_binary(const char *filename) {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot open file %s\n", filename);
-        return NULL;
-    }
-
-    Graph *graph = malloc(sizeof(Graph));
-
-    // Read max_neighbors
-    if (fread(&graph->max_neighbors, sizeof(int), 1, fp) != 1) {
-        fprintf(stderr, "Error: Failed to read max_neighbors from %s\n", filename);
-        free(graph);
-        fclose(fp);
-        return NULL;
-    }
-
-    // Read xadj size (nvtxs + 1)
-    int xadj_size;
-    if (fread(&xadj_size, sizeof(int), 1, fp) != 1) {
-        fprintf(stderr, "Error: Failed to read xadj_size from %s\n", filename);
-        free(graph);
-        fclose(fp);
-        return NULL;
-    }
-    graph->nvtxs = xadj_size - 1;
-
-    // Read adjncy size (from last element of xadj)
-    int adjncy_size;
-    if (fread(&adjncy_size, sizeof(int), 1, fp) != 1) {
-        fprintf(stderr, "Error: Failed to read adjncy_size from %s\n", filename);
-        free(graph);
-        fclose(fp);
-        return NULL;
-    }
-
-    // Read num_components
-    if (fread(&graph->num_components, sizeof(int), 1, fp) != 1) {
-        fprintf(stderr, "Error: Failed to read num_components from %s\n", filename);
-        free(graph);
-        fclose(fp);
-        return NULL;
-    }
-
-    // Calculate component size
-    int components_size;
-    if (fread(&components_size, sizeof(int), 1, fp) != 1) {
-        fprintf(stderr, "Error: Failed to read components_size from %s\n", filename);
-        free(graph);
-        fclose(fp);
-        return NULL;
-    }
-
-    // Allocate memory for all arrays
-    graph->xadj = malloc(xadj_size * sizeof(int));
-    graph->adjncy = malloc(adjncy_size * sizeof(int));
-    graph->component_ptr = malloc((graph->num_components + 1) * sizeof(int));
-    graph->components = malloc(components_size * sizeof(int));
-
-    // Read xadj array
-    if (fread(graph->xadj, sizeof(int), xadj_size, fp) != xadj_size) {
-        fprintf(stderr, "Error: Failed to read xadj from %s\n", filename);
-        free_graph(graph);
-        fclose(fp);
-        return NULL;
-    }
-
-    // Read adjncy array
-    if (fread(graph->adjncy, sizeof(int), adjncy_size, fp) != adjncy_size) {
-        fprintf(stderr, "Error: Failed to read adjncy from %s\n", filename);
-        free_graph(graph);
-        fclose(fp);
-        return NULL;
-    }
-
-    // Read component_ptr array
-    if (fread(graph->component_ptr, sizeof(int), graph->num_components + 1, fp) != graph->num_components + 1) {
-        fprintf(stderr, "Error: Failed to read component_ptr from %s\n", filename);
-        free_graph(graph);
-        fclose(fp);
-        return NULL;
-    }
-
-    // Read components array
-    if (fread(graph->components, sizeof(int), components_size, fp) != components_size) {
-        fprintf(stderr, "Error: Failed to read components from %s\n", filename);
-        free_graph(graph);
-        fclose(fp);
-        return NULL;
-    }
+void print_usage(const char *program_name) {
+    printf("Usage: %s <input_file> [format] [num_parts] [error_margine] \n", program_name);
+    printf("       %s --serve <socket_path>\n", program_name);
+    printf("  format: Output format - 'text' or 'binary' (default: same as input)\n");
+    printf("  input_file: Path to input graph file (.csrrg for text, .bin for binary)\n");
+    printf("  num_parts: Number of output parts to generate (default: 1)\n");
+    printf("  error_margine \n");
+    printf("Options:\n");
+    printf("  --seeds N: Run N partitioning attempts with different seeds in parallel and keep the best cut (default: 1)\n");
+    printf("  --compute-components: Compute connected components from the edges instead of trusting the input file\n");
+    printf("  --by-component: Partition large components independently in parallel and pack small ones (implies --compute-components)\n");
+    printf("  --refine: Improve the assignment with parallel boundary moves that respect error_margine\n");
+    printf("  --parts-in FILE: Use the part assignment from FILE (e.g. a previous --parts-out) instead of METIS\n");
+    printf("  --parts-out FILE: Save the final part assignment to FILE\n");
+    printf("  --max-memory SIZE: Keep the estimated peak memory under SIZE (K/M/G suffix), running fewer --seeds attempts at once if needed; fail early if impossible\n");
+    printf("  --serve PATH: Keep graphs loaded and serve partition requests on a Unix domain socket (see graph_server.h)\n");
+    printf("  --server-threads N: Number of requests served concurrently in --serve mode (default: number of cores)\n");
+    printf("  --writers N: Number of threads writing partitions while the next ones are extracted (default: 1, with --ordering: cores)\n");
+    printf("  --ordering: Write a nested-dissection fill-reducing ordering (partN.perm, partN.iperm) for each partition\n");
 
-    fclose(fp);
-    return graph;
 }
 
-Graph* read_graph(const char *filename) {
-    if (detect_file_type(filename) == BINARY_MODE) {
-        return read_graph_binary(filename);
-    } else {
-        return read_graph_text(filename);
-    }
+// Kolejka partycji czekających na zapis; wątki zapisujące działają równolegle
+// z wyodrębnianiem kolejnych partycji, a każda partycja jest zwalniana zaraz po zapisie
+typedef struct {
+    Graph **graphs;
+    int *indices;
+    int capacity;
+    int head;
+    int count;
+    int closed;
+    const char *format;
+    int ordering;
+    int failed;     // błąd zapisu lub uporządkowania którejkolwiek partycji
+
+    // Tryb --max-memory: partycje zbudowane, ale jeszcze niezwolnione, nie mogą
+    // przekroczyć bytes_limit (part_bytes to rozmiary wyliczone przed budową)
+    const size_t *part_bytes;
+    int parts_count;
+    size_t bytes_limit;
+    size_t bytes_in_flight;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} WriteQueue;
+
+int write_queue_init(WriteQueue *queue, int capacity, const char *format) {
+    queue->graphs = malloc(capacity * sizeof(Graph*));
+    queue->indices = malloc(capacity * sizeof(int));
+    if (!queue->graphs || !queue->indices) {
+        free(queue->graphs);
+        free(queue->indices);
+        return -1;
+    }
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    queue->format = format;
+    queue->ordering = 0;
+    queue->failed = 0;
+    queue->part_bytes = NULL;
+    queue->parts_count = 0;
+    queue->bytes_limit = 0;
+    queue->bytes_in_flight = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return 0;
 }
 
-void write_graph_text(const char *filename, Graph *graph) {
-    FILE *out = fopen(filename, "w");
-    if (!out) {
-        perror("Error writing file");
-        return;
-    }
-
-    // Section 1
-    fprintf(out, "%d\n", graph->max_neighbors);
-
-    // Section 2
-    for (int i = 0; i < graph->xadj[graph->nvtxs]; i++) {
-        fprintf(out, "%d%c", graph->adjncy[i],
-            (i == graph->xadj[graph->nvtxs]-1) ? '\n' : ';');
-    }
-
-    // Section 3
-    for (int i = 0; i <= graph->nvtxs; i++) {
-        fprintf(out, "%d%c", graph->xadj[i],
-            (i == graph->nvtxs) ? '\n' : ';');
-    }
-
-    // Section 4
-    for (int i = 0; i < graph->component_ptr[graph->num_components]; i++) {
-        fprintf(out, "%d%c", graph->components[i],
-            (i == graph->component_ptr[graph->num_components]-1) ? '\n' : ';');
-    }
-
-    // Section 5
-    for (int i = 0; i <= graph->num_components; i++) {
-        fprintf(out, "%d%c", graph->component_ptr[i],
-            (i == graph->num_components) ? '\n' : ';');
-    }
-
-    fclose(out);
+void write_queue_destroy(WriteQueue *queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->graphs);
+    free(queue->indices);
 }
 
-void write_graph_binary(const char *filename, Graph *graph) {
-    FILE *out = fopen(filename, "wb");
-    if (!out) {
-        perror("Error writing binary file");
-        return;
+// Producent: wypisuje partycję i przekazuje ją do zapisu, czekając gdy kolejka jest pełna
+int write_queue_push(Graph *part_graph, int part_index, void *ctx) {
+    WriteQueue *queue = ctx;
+
+    flockfile(stdout);
+    print_graph_info(part_graph, "podzielony");
+    funlockfile(stdout);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    int tail = (queue->head + queue->count) % queue->capacity;
+    queue->graphs[tail] = part_graph;
+    queue->indices[tail] = part_index;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+
+    // Kolejną partycję budujemy dopiero, gdy zmieści się w budżecie obok
+    // partycji czekających na zapis
+    if (queue->bytes_limit) {
+        queue->bytes_in_flight += queue->part_bytes[part_index];
+        if (part_index + 1 < queue->parts_count) {
+            size_t next = queue->part_bytes[part_index + 1];
+            while (queue->bytes_in_flight > 0 && queue->bytes_in_flight + next > queue->bytes_limit) {
+                pthread_cond_wait(&queue->not_full, &queue->lock);
+            }
+        }
     }
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
 
-    // Write max_neighbors
-    fwrite(&graph->max_neighbors, sizeof(int), 1, out);
-
-    // Write xadj size
-    int xadj_size = graph->nvtxs + 1;
-    fwrite(&xadj_size, sizeof(int), 1, out);
+void write_queue_close(WriteQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
 
-    // Write adjncy size
-    int adjncy_size = graph->xadj[graph->nvtxs];
-    fwrite(&adjncy_size, sizeof(int), 1, out);
+void *write_queue_worker(void *arg) {
+    WriteQueue *queue = arg;
 
-    // Write num_components
-    fwrite(&graph->num_components, sizeof(int), 1, out);
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->count == 0 && !queue->closed) {
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        }
+        if (queue->count == 0) {
+            pthread_mutex_unlock(&queue->lock);
+            break;
+        }
+        Graph *part_graph = queue->graphs[queue->head];
+        int part_index = queue->indices[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+        pthread_mutex_unlock(&queue->lock);
 
-    // Write components size
-    int components_size = graph->component_ptr[graph->num_components];
-    fwrite(&components_size, sizeof(int), 1, out);
+        char filename[100];
+        int failed;
+        if (strcmp(queue->format, "binary") == 0) {
+            sprintf(filename, "part%d.bin", part_index);
+            failed = write_graph(filename, part_graph, "binary") != 0;
+        } else {
+            sprintf(filename, "part%d.csrrg", part_index);
+            failed = write_graph(filename, part_graph, "text") != 0;
+        }
 
-    // Write arrays
-    fwrite(graph->xadj, sizeof(int), xadj_size, out);
-    fwrite(graph->adjncy, sizeof(int), adjncy_size, out);
-    fwrite(graph->component_ptr, sizeof(int), graph->num_components + 1, out);
-    fwrite(graph->components, sizeof(int), components_size, out);
+        if (!failed) printf("Generated: %s\n", filename);
+
+        // Uporządkowanie dla solvera liczone równolegle w wątkach zapisujących
+        if (queue->ordering) {
+            idx_t *perm, *iperm;
+            if (compute_fill_ordering(part_graph, &perm, &iperm) == 0) {
+                sprintf(filename, "part%d.perm", part_index);
+                int perm_failed = write_idx_array(filename, perm, part_graph->nvtxs) != 0;
+                sprintf(filename, "part%d.iperm", part_index);
+                perm_failed |= write_idx_array(filename, iperm, part_graph->nvtxs) != 0;
+                if (perm_failed) {
+                    fprintf(stderr, "Error: Failed to write ordering of partition %d\n", part_index);
+                    failed = 1;
+                } else {
+                    printf("Generated: part%d.perm, part%d.iperm\n", part_index, part_index);
+                }
+                free(perm);
+                free(iperm);
+            } else {
+                failed = 1;
+            }
+        }
 
-    fclose(out);
-}
+        if (failed) {
+            pthread_mutex_lock(&queue->lock);
+            queue->failed = 1;
+            pthread_mutex_unlock(&queue->lock);
+        }
+        free_graph(part_graph);
 
-void write_graph(const char *filename, Graph *graph, const char *format) {
-    if (format && strcmp(format, "binary") == 0) {
-        write_graph_binary(filename, graph);
-    } else {
-        write_graph_text(filename, graph);
+        if (queue->bytes_limit) {
+            pthread_mutex_lock(&queue->lock);
+            queue->bytes_in_flight -= queue->part_bytes[part_index];
+            pthread_cond_signal(&queue->not_full);
+            pthread_mutex_unlock(&queue->lock);
+        }
     }
+    return NULL;
 }
 
-void free_graph(Graph *graph) {
-    if (graph) {
-        if (graph->adjncy) free(graph->adjncy);
-        if (graph->xadj) free(graph->xadj);
-        if (graph->components) free(graph->components);
-        if (graph->component_ptr) free(graph->component_ptr);
-        free(graph);
+int main(int argc, char **argv) {
+    int seeds = 1;
+    int writers = 0;
+    int ordering = 0;
+    int compute = 0;
+    int by_component = 0;
+    const char *socket_path = NULL;
+    int server_threads = 0;
+    size_t max_memory = 0;
+    int refine = 0;
+    const char *parts_in = NULL;
+    const char *parts_out = NULL;
+
+    // Opcje --nazwa wartość mogą wystąpić w dowolnym miejscu; usuwamy je z argv,
+    // żeby argumenty pozycyjne zachowały dotychczasowe numery
+    int positional = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seeds") == 0) {
+            if (i + 1 >= argc || (seeds = atoi(argv[++i])) < 1) {
+                fprintf(stderr, "Error: --seeds requires a number ≥ 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--writers") == 0) {
+            if (i + 1 >= argc || (writers = atoi(argv[++i])) < 1) {
+                fprintf(stderr, "Error: --writers requires a number ≥ 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--compute-components") == 0) {
+            compute = 1;
+        } else if (strcmp(argv[i], "--by-component") == 0) {
+            compute = 1;
+            by_component = 1;
+        } else if (strcmp(argv[i], "--ordering") == 0) {
+            ordering = 1;
+        } else if (strcmp(argv[i], "--refine") == 0) {
+            refine = 1;
+        } else if (strcmp(argv[i], "--parts-in") == 0 || strcmp(argv[i], "--parts-out") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires a file name\n", argv[i]);
+                return 1;
+            }
+            if (strcmp(argv[i], "--parts-in") == 0) {
+                parts_in = argv[++i];
+            } else {
+                parts_out = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--max-memory") == 0) {
+            if (i + 1 >= argc || (max_memory = parse_memory_size(argv[++i])) == 0) {
+                fprintf(stderr, "Error: --max-memory requires a size such as 512M or 16G\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --serve requires a socket path\n");
+                return 1;
+            }
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--server-threads") == 0) {
+            if (i + 1 >= argc || (server_threads = atoi(argv[++i])) < 1) {
+                fprintf(stderr, "Error: --server-threads requires a number ≥ 1\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            argv[positional++] = argv[i];
+        }
     }
-}
+    argc = positional;
 
-void print_usage(const char *program_name) {
-    printf("Usage: %s <input_file> [format] [num_parts] [error_margine] \n", program_name);
-    printf("  format: Output format - 'text' or 'binary' (default: same as input)\n");
-    printf("  input_file: Path to input graph file (.csrrg for text, .bin for binary)\n");
-    printf("  num_parts: Number of output parts to generate (default: 1)\n");
-    printf("  error_margine \n");
-
-}
+    // Tryb serwera: grafy pozostają wczytane między żądaniami
+    if (socket_path) {
+        // Wątek jest zajęty tylko na czas jednego żądania, więc wystarczy po jednym na rdzeń
+        if (server_threads == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            server_threads = cpus > 0 ? (int)cpus : 1;
+        }
+        return run_graph_server(socket_path, server_threads) == 0 ? 0 : 1;
+    }
 
-int main(int argc, char **argv) {
     if (argc < 2) {
         print_usage(argv[0]);
         return 1;
     }
 
    // Remove old output files
+    const char *extensions[] = {"csrrg", "bin", "perm", "iperm"};
     for (int k = 0; k < 1000; k++) {
-        char filename[100];
-
-        // Dla .csrrg
-        sprintf(filename, "part%d.csrrg", k);
-        if (strcmp(filename, argv[1]) == 0) continue; // Fix 2: Pomijaj input
-        FILE *file = fopen(filename, "r");
-        if (!file) continue;
-        fclose(file);
-        remove(filename);
-
-        // Dla .bin
-        sprintf(filename, "part%d.bin", k);
-        if (strcmp(filename, argv[1]) == 0) continue; // Fix 2: Pomijaj input
-        file = fopen(filename, "r");
-        if (!file) continue;
-        fclose(file);
-        remove(filename);
+        for (int x = 0; x < 4; x++) {
+            char filename[100];
+            sprintf(filename, "part%d.%s", k, extensions[x]);
+            if (strcmp(filename, argv[1]) == 0) continue; // Fix 2: Pomijaj input
+            FILE *file = fopen(filename, "r");
+            if (!file) continue;
+            fclose(file);
+            remove(filename);
+        }
     }
 
     // Parse command line arguments
@@ -351,25 +386,93 @@ int main(int argc, char **argv) {
         }
     }
 
+    // Plik binarny ma rozmiary w nagłówku - budżet sprawdzamy, zanim wczytamy tablice.
+    // Przyjmujemy jedną próbę naraz; dokładniejsze sprawdzenie następuje po wczytaniu.
+    if (max_memory && detect_file_type(argv[1]) == BINARY_MODE) {
+        gidx_t nvtxs, num_components;
+        goff_t edges;
+        if (read_graph_binary_header(argv[1], &nvtxs, &edges, &num_components) != 0) return 1;
+        size_t partitioning = parts_in ? 0 :
+            estimate_partitioning_bytes(nvtxs, edges, num_components, num_parts, 1, by_component);
+        size_t extraction = estimate_extraction_bytes(nvtxs, edges, num_components, num_parts)
+            + graph_bytes(nvtxs / num_parts, edges / num_parts, 1);
+        if (partitioning > max_memory || extraction > max_memory) {
+            print_memory_budget_error(max_memory, partitioning, extraction);
+            return 1;
+        }
+    }
+
     // Read input graph
     Graph *graph = read_graph(argv[1]);
     if (!graph) return 1;
 
 	if (num_parts > graph->nvtxs) {
-        fprintf(stderr, "Błąd: Liczba partycji (%d) przekracza liczbę wierzchołków (%d)\n",
+        fprintf(stderr, "Błąd: Liczba partycji (%d) przekracza liczbę wierzchołków (%" PRIgidx ")\n",
                num_parts, graph->nvtxs);
         free_graph(graph);
         return 1;
     }
 
+    if (compute && compute_components(graph) != 0) {
+        free_graph(graph);
+        return 1;
+    }
+
+    // Sprawdzenie budżetu pamięci, zanim zaczniemy kosztowne partycjonowanie.
+    // Wszystkie ziarna są sprawdzane, ale równolegle tylko tyle prób, ile mieści budżet.
+    int parallel_attempts = seeds;
+    if (max_memory) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int attempts = (cpus > 0 && seeds > cpus) ? (int)cpus : seeds;
+        size_t partitioning = 0;
+        gidx_t nvtxs = graph->nvtxs;
+        goff_t edges = graph->xadj[nvtxs];
+        if (!parts_in) {
+            partitioning = estimate_partitioning_bytes(nvtxs, edges, graph->num_components,
+                                                       num_parts, attempts, by_component);
+            while (attempts > 1 && partitioning > max_memory) {
+                attempts--;
+                partitioning = estimate_partitioning_bytes(nvtxs, edges, graph->num_components,
+                                                           num_parts, attempts, by_component);
+            }
+        }
+        size_t extraction = estimate_extraction_bytes(nvtxs, edges, graph->num_components, num_parts)
+            + graph_bytes(nvtxs / num_parts, edges / num_parts, 1);
+        if (partitioning > max_memory || extraction > max_memory) {
+            print_memory_budget_error(max_memory, partitioning, extraction);
+            free_graph(graph);
+            return 1;
+        }
+        char budget_text[32], partitioning_text[32];
+        format_memory_size(max_memory, budget_text, sizeof(budget_text));
+        format_memory_size(partitioning, partitioning_text, sizeof(partitioning_text));
+        parallel_attempts = attempts;
+        if (seeds > 1 && !parts_in) {
+            printf("Budżet pamięci %s, szacowany szczyt partycjonowania %s (%d z %d prób równolegle)\n",
+                   budget_text, partitioning_text, attempts, seeds);
+        } else {
+            printf("Budżet pamięci %s, szacowany szczyt partycjonowania %s\n", budget_text, partitioning_text);
+        }
+    }
+
     // Wypisanie danych grafu
     print_graph_info(graph, "oryginalny");
 
     // Przygotowanie do partycjonowania
     float margine = 1.0 + (error_margine)/100; 
-    int deleted_edges;
-
-    idx_t *parts = Graph_parts(graph, num_parts, margine, &deleted_edges);
+    goff_t deleted_edges = 0;
+
+    idx_t *parts;
+    if (parts_in) {
+        parts = read_parts(parts_in, graph->nvtxs, num_parts);
+        // Wczytane przypisanie nie przechodzi przez METIS - cięcie liczymy sami
+        if (parts) deleted_edges = partition_edge_cut(graph, parts);
+    } else if (by_component) {
+        parts = Graph_parts_by_component(graph, num_parts, margine, seeds, 0, &deleted_edges);
+    } else {
+        // Żadne inne wątki jeszcze nie działają, więc próby mogą iść w procesach potomnych
+        parts = Graph_parts_multi(graph, num_parts, margine, seeds, parallel_attempts, &deleted_edges);
+    }
     
     if (parts == NULL) {
         printf("Błąd podczas partycjonowania grafu.\n");
@@ -377,41 +480,109 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (refine) {
+        goff_t cut_before;
+        if (refine_partition(graph, parts, num_parts, margine, &cut_before, &deleted_edges) != 0) {
+            free(parts);
+            free_graph(graph);
+            return 1;
+        }
+    }
+
+    if (parts_out && write_idx_array(parts_out, parts, graph->nvtxs) != 0) {
+        fprintf(stderr, "Error: Failed to write %s\n", parts_out);
+    }
+
 
     printf("Partycje: {");
-    for(int i = 0; i < graph->nvtxs; i++) {
-        printf("%d", parts[i]);
+    for(gidx_t i = 0; i < graph->nvtxs; i++) {
+        printf("%" PRIDX, parts[i]);
         if (i < graph->nvtxs - 1) printf(", ");
     }
     printf("}\n");
 
-    // Tworzenie nowych grafów na podstawie partycjonowania
-    Graph** New_Graphs = graph_partition(graph, parts, num_parts, margine);
-    
-    if (New_Graphs == NULL) {
-        printf("Błąd podczas tworzenia nowych grafów.\n");
+    // Tworzenie nowych grafów na podstawie partycjonowania; każda partycja trafia
+    // do wątków zapisujących od razu po zbudowaniu
+    if (writers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        writers = (ordering && cpus > 1) ? (int)cpus : 1;
+    }
+
+    WriteQueue queue;
+    if (write_queue_init(&queue, writers, format) != 0) {
+        fprintf(stderr, "Error: Unable to allocate write queue\n");
+        free(parts);
+        free_graph(graph);
+        return 1;
+    }
+    queue.ordering = ordering;
+
+    pthread_t *writer_threads = malloc(writers * sizeof(pthread_t));
+    int started = 0;
+    while (writer_threads && started < writers &&
+           pthread_create(&writer_threads[started], NULL, write_queue_worker, &queue) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Error: Unable to start writer threads\n");
+        free(writer_threads);
+        write_queue_destroy(&queue);
         free(parts);
         free_graph(graph);
         return 1;
     }
-    
-    // Generate output files
-    for (int i = 0; i < num_parts; i++) {
-        char filename[100];
-	print_graph_info(New_Graphs[i], "podzielony");
-        if (strcmp(format, "binary") == 0) {
-            sprintf(filename, "part%d.bin", i);
-            write_graph(filename, New_Graphs[i], "binary");
-        } else {
-            sprintf(filename, "part%d.csrrg", i);
-            write_graph(filename, New_Graphs[i], "text");
 
+    // Partycje są budowane i zwalniane grupami mieszczącymi się w budżecie
+    size_t *part_bytes = NULL;
+    int status = 0;
+    if (max_memory) {
+        size_t extraction = estimate_extraction_bytes(graph->nvtxs, graph->xadj[graph->nvtxs],
+                                                      graph->num_components, num_parts);
+        part_bytes = malloc(num_parts * sizeof(size_t));
+        if (!part_bytes || partition_bytes(graph, parts, num_parts, ordering, part_bytes) != 0) {
+            status = -1;
+        } else {
+            size_t largest = 0;
+            for (int i = 0; i < num_parts; i++) {
+                if (part_bytes[i] > largest) largest = part_bytes[i];
+            }
+            if (extraction + largest > max_memory) {
+                char budget_text[32], largest_text[32], extraction_text[32];
+                fprintf(stderr, "Error: --max-memory %s is too small, largest partition needs %s on top of %s\n",
+                        format_memory_size(max_memory, budget_text, sizeof(budget_text)),
+                        format_memory_size(largest, largest_text, sizeof(largest_text)),
+                        format_memory_size(extraction, extraction_text, sizeof(extraction_text)));
+                status = -1;
+            } else {
+                queue.part_bytes = part_bytes;
+                queue.parts_count = num_parts;
+                queue.bytes_limit = max_memory - extraction;
+            }
         }
+    }
 
-        printf("Generated: %s\n", filename);
-	free_graph(New_Graphs[i]);
+    if (status == 0) {
+        status = graph_partition_stream(graph, parts, num_parts, write_queue_push, &queue);
     }
 
+    write_queue_close(&queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(writer_threads[i], NULL);
+    }
+    int write_failed = queue.failed;
+    free(writer_threads);
+    write_queue_destroy(&queue);
+    free(part_bytes);
+    free(parts);
     free_graph(graph);
+
+    if (status != 0) {
+        printf("Błąd podczas tworzenia nowych grafów.\n");
+        return 1;
+    }
+    if (write_failed) {
+        printf("Błąd podczas zapisu partycji.\n");
+        return 1;
+    }
     return 0;
 }